@@ -0,0 +1,111 @@
+# LL(1)-грамматика языка Милан с семантическими действиями.
+#
+# Файл читается генератором tools/llgen.cpp, который вычисляет множества
+# FIRST и FOLLOW, проверяет грамматику на LL(1) и записывает таблицу разбора
+# в заголовок milan_ll1.h. Разбор по таблице выполняет Parser::parseLL1().
+#
+# Правило:    нетерминал -> альтернатива | альтернатива ... ;
+# Терминалы записываются большими буквами (имя лексемы без T_),
+# нетерминалы - маленькими, семантические действия начинаются с '@'.
+# Пустая альтернатива - эпсилон-правило.
+#
+# Если для нетерминала и текущей лексемы в таблице нет правила, используется
+# правило по умолчанию: альтернатива, отмеченная словом default, иначе
+# эпсилон-правило, иначе последняя альтернатива. Для нетерминалов с сообщением
+# (строка "нетерминал ! текст") и без default вместо этого выдается сообщение
+# об ошибке и нетерминал пропускается.
+#
+# Конфликт непустого правила с эпсилон-правилом решается в пользу непустого,
+# поэтому операнд "!" захватывает все операции с большим приоритетом:
+# "!a < b" означает "!(a < b)", как и в Parser::expression().
+#
+# Действие, стоящее перед терминалом, видит значение этого терминала
+# (имя переменной, число, вид операции).
+
+program     -> BEGIN stmts END @stop ;
+
+# Как и Parser::statementList(): список пуст только перед END, OD, ELSE, FI, ESAC
+stmts       -> default stmt stmts_tail
+             | ;
+
+stmts_tail  -> SEMICOLON stmt stmts_tail
+             | ;
+
+stmt        -> @assign_target IDENTIFIER ASSIGN expr @assign
+             | IF expr @if_cond THEN stmts else_part FI
+             | WHILE @while_begin expr @while_cond DO stmts OD @while_end
+             | FOR @for_target IDENTIFIER ASSIGN expr @for_init @for_to expr step_part DO @for_begin stmts OD @for_end
+             | CASE expr @case_of case_arms ESAC @case_end
+             | WRITE LPAREN expr RPAREN @write
+             | READ @read
+             | BREAK @break
+             | CONTINUE @continue ;
+
+stmt        ! statement expected.
+
+else_part   -> ELSE @else stmts @if_end
+             | @if_end ;
+
+# Слова to и step - идентификаторы с этим именем (Parser::mustBeWord());
+# шаг опущен только перед DO, шаг-константа 0 - ошибка (Parser::forStep())
+step_part   -> default @for_step expr @for_step_end
+             | @step_default ;
+
+# Варианты case: метка - число со знаком или без; действие перед NUMBER
+# вызывает Parser::caseLabel(). Знак метки хранится в semStack_ от @case_sign
+# до @case_signed
+case_arms   -> @case_label NUMBER COLON arm_stmts @case_arm_end case_arms
+             | @case_sign ADDOP @case_signed NUMBER COLON arm_stmts @case_arm_end case_arms
+             | ELSE @case_else stmts
+             | ;
+
+# Как и Parser::caseStatements(): операторы варианта идут до метки следующего
+# варианта, ELSE или ESAC; лишние ";" (и пустой вариант "1: ;") допустимы
+arm_stmts   -> SEMICOLON arm_stmts
+             | default stmt arm_tail
+             | ;
+
+arm_tail    -> SEMICOLON arm_stmts
+             | ;
+
+# Выражения: уровни приоритета те же, что в Parser::expression()
+
+expr        -> and_expr or_tail ;
+
+or_tail     -> OR @or_begin and_expr @or_end or_tail
+             | BITOR and_expr @bitor or_tail
+             | ;
+
+and_expr    -> cmp_expr and_tail ;
+
+and_tail    -> AND @and_begin cmp_expr @and_end and_tail
+             | BITAND cmp_expr @bitand and_tail
+             | ;
+
+cmp_expr    -> sum cmp_tail ;
+
+cmp_tail    -> @push_cmp CMP sum @cmp cmp_tail
+             | ;
+
+sum         -> prod sum_tail ;
+
+sum_tail    -> @push_arith ADDOP prod @arith sum_tail
+             | ;
+
+prod        -> unary prod_tail ;
+
+prod_tail   -> @push_arith MULOP unary @arith prod_tail
+             | ;
+
+unary       -> @minus ADDOP unary @invert
+             | NOT cmp_expr @not
+             | primary ;
+
+primary     -> @number NUMBER
+             | @load IDENTIFIER
+             | READ @input
+             | TRUE @true
+             | FALSE @false
+             | LPAREN expr RPAREN ;
+
+primary     ! expression expected.
@@ -2,7 +2,11 @@
 #define CMILAN_CODEGEN_H
 
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include <memory_resource>
 #include <iostream>
+#include <cstdint>
 
 using namespace std;
 
@@ -40,9 +44,59 @@ enum Instruction
     PUSH_TRUE,  // загрузка в стек значения 1 (true)
     PUSH_FALSE, // загрузка в стек значения 0 (false)
     SHORT_AND,  // начало логического И с коротким замыканием (&&), принимает адрес для перехода
-    SHORT_OR    // начало логического ИЛИ с коротким замыканием (||), принимает адрес для перехода
+    SHORT_OR,   // начало логического ИЛИ с коротким замыканием (||), принимает адрес для перехода
+    SHL,        // SHL k - сдвиг слова на вершине стека влево на k бит
+    SHR,        // SHR k - арифметический сдвиг слова на вершине стека вправо на k бит
+    MULHI,      // MULHI m - старшие 32 бита 64-битного произведения слова на вершине стека на m
+    FOR_ENTRY,  // FOR_ENTRY addr var - вход в цикл for: переход по адресу addr, если шаг (вершина стека)
+                // равен 0 или переменная var больше предела (слово под шагом), а при отрицательном
+                // шаге - меньше. Стек не меняется
+    FOR_LOOP,   // FOR_LOOP addr var - к переменной var прибавляется шаг (вершина стека); если точная
+                // сумма не больше предела (слово под шагом), а при отрицательном шаге - не меньше,
+                // переход по адресу addr. Сумма, вышедшая за пределы int, записывается по модулю 2^32
+                // и перехода не дает. Стек не меняется
+    TABLESWITCH // TABLESWITCH low n - за инструкцией следуют n + 1 переходов JUMP (таблица);
+                // со стека снимается x, и выполняется переход номер x - low, если 0 <= x - low < n,
+                // иначе последний (по умолчанию)
 };
 
+const Instruction LAST_INSTRUCTION = TABLESWITCH;	// Инструкция с наибольшим кодом
+
+// Аргумент инструкции - адрес инструкции (переход)
+inline bool hasCodeAddress(Instruction instruction)
+{
+	return instruction == JUMP || instruction == JUMP_YES || instruction == JUMP_NO ||
+		instruction == SHORT_AND || instruction == SHORT_OR || instruction == FOR_ENTRY || instruction == FOR_LOOP;
+}
+
+// У инструкции есть второй аргумент: адрес переменной цикла (FOR_ENTRY, FOR_LOOP)
+// или размер таблицы переходов (TABLESWITCH)
+inline bool hasSecondArgument(Instruction instruction)
+{
+	return instruction == FOR_ENTRY || instruction == FOR_LOOP || instruction == TABLESWITCH;
+}
+
+// Второй аргумент инструкции - адрес слова данных
+inline bool hasSecondDataAddress(Instruction instruction)
+{
+	return instruction == FOR_ENTRY || instruction == FOR_LOOP;
+}
+
+// Аргумент инструкции - адрес слова данных (переменной)
+inline bool hasDataAddress(Instruction instruction)
+{
+	return instruction == LOAD || instruction == STORE || instruction == BLOAD || instruction == BSTORE;
+}
+
+// У инструкции есть аргумент
+inline bool hasArgument(Instruction instruction)
+{
+	return hasCodeAddress(instruction) || hasDataAddress(instruction) || instruction == PUSH || instruction == COMPARE ||
+		instruction == SHL || instruction == SHR || instruction == MULHI || instruction == TABLESWITCH;
+}
+
+// Имя инструкции в тексте программы ("PUSH", "JUMP_NO", ...)
+const char* instructionName(Instruction instruction);
 
 
 
@@ -53,12 +107,17 @@ class Command
 public:
 	// Конструктор для инструкций без аргументов
 	Command(Instruction instruction)
-		: instruction_(instruction), arg_(0)
+		: instruction_(instruction), arg_(0), arg2_(0)
 	{}
 
 	// Конструктор для инструкций с одним аргументом
 	Command(Instruction instruction, int arg)
-		: instruction_(instruction), arg_(arg)
+		: instruction_(instruction), arg_(arg), arg2_(0)
+	{}
+
+	// Конструктор для инструкций с двумя аргументами (FOR_ENTRY, FOR_LOOP, TABLESWITCH)
+	Command(Instruction instruction, int arg, int arg2)
+		: instruction_(instruction), arg_(arg), arg2_(arg2)
 	{}
 
 	// Печать инструкции
@@ -66,9 +125,247 @@ public:
 	//     ostream& os - поток вывода, куда будет напечатана инструкция
 	void print(int address, ostream& os);
 
+	// Код инструкции
+	Instruction instruction() const
+	{
+		return instruction_;
+	}
+
+	// Аргумент инструкции
+	int arg() const
+	{
+		return arg_;
+	}
+
+	// Второй аргумент инструкции
+	int arg2() const
+	{
+		return arg2_;
+	}
+
 private:
 	Instruction instruction_; // Код инструкции
 	int arg_;				  // Аргумент инструкции
+	int arg2_;				  // Второй аргумент (hasSecondArgument)
+};
+
+// Буфер инструкций программы.
+//
+// Каждая инструкция хранится в одном 32-битном слове: старшие 8 бит - код
+// инструкции, младшие 24 бита - аргумент (знаковое число). Если аргумент не
+// помещается в 24 бита, в коде инструкции выставляется флаг WIDE_FLAG, а в поле
+// аргумента записывается индекс в таблице широких аргументов wideArgs_.
+// Таким образом адрес инструкции всегда совпадает с номером ее слова.
+//
+// Слова хранятся в сегментах фиксированного размера. При росте программы
+// добавляется новый сегмент, уже записанные инструкции никогда не копируются.
+// Начальные сегменты, которые больше не нужны, можно освободить (release);
+// такие сегменты и ячейки широких аргументов их инструкций используются
+// повторно. Память берется из memory_resource, переданного в конструктор.
+
+class CommandBuffer
+{
+public:
+	explicit CommandBuffer(pmr::memory_resource* memory = pmr::get_default_resource())
+		: memory_(memory), segments_(memory), wideArgs_(memory), secondArgs_(memory), freeWideSlots_(memory),
+		  spareSegments_(memory),
+		  size_(0), firstSegment_(0)
+	{}
+
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+	~CommandBuffer()
+	{
+		for(uint32_t* segment : segments_) {
+			freeSegment(segment);
+		}
+		for(uint32_t* segment : spareSegments_) {
+			freeSegment(segment);
+		}
+	}
+
+	// Добавление инструкции в конец буфера
+	void push(Instruction instruction, int arg, int arg2 = 0)
+	{
+		if((size_ & SEGMENT_MASK) == 0) {
+			segments_.push_back(newSegment());
+		}
+		word(size_) = encode(instruction, arg, NO_WIDE_SLOT, arg2);
+		++size_;
+	}
+
+	// Замена инструкции по указанному адресу; второй аргумент сохраняется.
+	// Если новая инструкция помещается в слово, ее ячейка широких аргументов освобождается.
+	void set(int address, Instruction instruction, int arg)
+	{
+		uint32_t& w = word(address);
+		if(isWide(w)) {
+			uint32_t slot = w & ARG_MASK;
+			w = encode(instruction, arg, slot, secondArgs_[slot]);
+			if(!isWide(w)) {
+				freeWideSlots_.push_back(slot);
+			}
+		}
+		else {
+			w = encode(instruction, arg, NO_WIDE_SLOT, 0);
+		}
+	}
+
+	// Код инструкции по указанному адресу
+	Instruction instruction(int address) const
+	{
+		return static_cast<Instruction>((word(address) >> ARG_BITS) & ~WIDE_FLAG);
+	}
+
+	// Аргумент инструкции по указанному адресу
+	int arg(int address) const
+	{
+		uint32_t w = word(address);
+		if(isWide(w)) {
+			return wideArgs_[w & ARG_MASK];
+		}
+		// Расширение знака 24-битного поля
+		return static_cast<int32_t>(w << (32 - ARG_BITS)) >> (32 - ARG_BITS);
+	}
+
+	// Второй аргумент инструкции по указанному адресу
+	int arg2(int address) const
+	{
+		uint32_t w = word(address);
+		return isWide(w) ? secondArgs_[w & ARG_MASK] : 0;
+	}
+
+	// Инструкция по указанному адресу в распакованном виде
+	Command at(int address) const
+	{
+		return Command(instruction(address), arg(address), arg2(address));
+	}
+
+	// Количество инструкций в буфере
+	int size() const
+	{
+		return size_;
+	}
+
+	// Адрес первой инструкции, которая еще хранится в буфере
+	int firstAddress() const
+	{
+		return firstSegment_ << SEGMENT_BITS;
+	}
+
+	// Удаление всех инструкций; сегменты и ячейки широких аргументов используются повторно
+	void clear()
+	{
+		for(uint32_t* segment : segments_) {
+			spareSegments_.push_back(segment);
+		}
+		segments_.clear();
+		wideArgs_.clear();
+		secondArgs_.clear();
+		freeWideSlots_.clear();
+		size_ = 0;
+		firstSegment_ = 0;
+	}
+
+	// Освобождение всех сегментов, целиком лежащих ниже адреса address.
+	// Обращаться к инструкциям ниже firstAddress() после этого нельзя.
+	void release(int address)
+	{
+		while(!segments_.empty() && ((firstSegment_ + 1) << SEGMENT_BITS) <= address) {
+			uint32_t* segment = segments_.front();
+			for(int i = 0; i < SEGMENT_SIZE; ++i) {
+				if(isWide(segment[i])) {
+					freeWideSlots_.push_back(segment[i] & ARG_MASK);
+				}
+			}
+			spareSegments_.push_back(segment);
+			segments_.pop_front();
+			++firstSegment_;
+		}
+	}
+
+private:
+	enum {
+		SEGMENT_BITS = 12,
+		SEGMENT_SIZE = 1 << SEGMENT_BITS,
+		SEGMENT_MASK = SEGMENT_SIZE - 1
+	};
+
+	static const int ARG_BITS = 24;
+	static const uint32_t ARG_MASK = (1u << ARG_BITS) - 1;
+	static const uint32_t WIDE_FLAG = 0x80;            // флаг в коде инструкции
+	static const uint32_t NO_WIDE_SLOT = 0xFFFFFFFFu;  // широкий аргумент еще не выделен
+
+	static bool isWide(uint32_t w)
+	{
+		return (w >> ARG_BITS) & WIDE_FLAG;
+	}
+
+	static bool fitsNarrow(int arg)
+	{
+		return arg >= -(1 << (ARG_BITS - 1)) && arg < (1 << (ARG_BITS - 1));
+	}
+
+	// Упаковка инструкции в слово. Для широкого аргумента используется
+	// уже выделенная ячейка wideSlot, если она есть. Инструкция с двумя
+	// аргументами всегда хранит их в ячейке широких аргументов.
+	uint32_t encode(Instruction instruction, int arg, uint32_t wideSlot, int arg2)
+	{
+		uint32_t code = static_cast<uint32_t>(instruction) << ARG_BITS;
+		if(fitsNarrow(arg) && !hasSecondArgument(instruction)) {
+			return code | (static_cast<uint32_t>(arg) & ARG_MASK);
+		}
+
+		if(wideSlot == NO_WIDE_SLOT && !freeWideSlots_.empty()) {
+			wideSlot = freeWideSlots_.back();
+			freeWideSlots_.pop_back();
+		}
+		if(wideSlot == NO_WIDE_SLOT) {
+			wideSlot = wideArgs_.size();
+			wideArgs_.push_back(arg);
+			secondArgs_.push_back(arg2);
+		}
+		else {
+			wideArgs_[wideSlot] = arg;
+			secondArgs_[wideSlot] = arg2;
+		}
+		return code | (WIDE_FLAG << ARG_BITS) | wideSlot;
+	}
+
+	uint32_t* newSegment()
+	{
+		if(!spareSegments_.empty()) {
+			uint32_t* segment = spareSegments_.back();
+			spareSegments_.pop_back();
+			return segment;
+		}
+		return static_cast<uint32_t*>(memory_->allocate(SEGMENT_SIZE * sizeof(uint32_t), alignof(uint32_t)));
+	}
+
+	void freeSegment(uint32_t* segment)
+	{
+		memory_->deallocate(segment, SEGMENT_SIZE * sizeof(uint32_t), alignof(uint32_t));
+	}
+
+	uint32_t& word(int address)
+	{
+		return segments_[(address >> SEGMENT_BITS) - firstSegment_][address & SEGMENT_MASK];
+	}
+
+	uint32_t word(int address) const
+	{
+		return segments_[(address >> SEGMENT_BITS) - firstSegment_][address & SEGMENT_MASK];
+	}
+
+	pmr::memory_resource* memory_;             // Источник памяти для сегментов
+	pmr::deque<uint32_t*> segments_;           // Сегменты с упакованными инструкциями
+	pmr::vector<int> wideArgs_;                // Аргументы, не поместившиеся в 24 бита
+	pmr::vector<int> secondArgs_;              // Вторые аргументы для ячеек wideArgs_
+	pmr::vector<uint32_t> freeWideSlots_;      // Ячейки wideArgs_ освобожденных инструкций
+	pmr::vector<uint32_t*> spareSegments_;     // Освобожденные сегменты для повторного использования
+	int size_;                                 // Количество инструкций
+	int firstSegment_;                         // Номер первого неосвобожденного сегмента
 };
 
 // Кодогенератор.
@@ -76,12 +373,31 @@ private:
 // - Формировать программу для виртуальной машины Милана
 // - Отслеживать адрес последней инструкции
 // - Буферизовать программу и печатать ее в указанный поток вывода
+// - Поддерживать метки для переходов вперед и назад
+//
+// Метки. Переход на метку, которая еще не привязана к адресу, записывается
+// в буфер с аргументом, указывающим на предыдущий ожидающий переход на ту же
+// метку (цепочка заплат хранится прямо в аргументах инструкций, -1 - конец цепочки).
+// Все адреса переходов вычисляются только при формировании программы (flush),
+// поэтому до этого момента программа не содержит абсолютных адресов переходов.
+//
+// Потоковый режим (streaming). Переход на уже привязанную метку сразу получает
+// адрес, а цепочка переходов на метку заполняется при ее привязке. Ожидают адреса
+// только переходы на еще не привязанные метки, поэтому все инструкции ниже самого
+// раннего из таких переходов окончательны: они печатаются по мере генерации, а их
+// сегменты освобождаются. Метки, которые больше не нужны анализатору, возвращаются
+// через freeLabel() и используются повторно. Память зависит от вложенности
+// конструкций, а не от длины программы. Последняя инструкция не печатается до
+// появления следующей: ее можно заменить через emitAt().
 
 class CodeGen
 {
 public:
-	explicit CodeGen(ostream& output)
-		: output_(output)
+	// Память для программы и таблиц берется из memory
+	explicit CodeGen(ostream& output, bool streaming = false,
+			pmr::memory_resource* memory = pmr::get_default_resource())
+		: output_(output), commandBuffer_(memory), labels_(memory), streaming_(streaming), written_(0),
+		  nextStream_(STREAM_BLOCK), openLabels_(memory), freeLabels_(memory), patches_(0), peakSize_(0)
 	{
 	}
 
@@ -91,6 +407,9 @@ public:
 	// Добавление инструкции с одним аргументом в конец программы
 	void emit(Instruction instruction, int arg);
 
+	// Добавление инструкции с двумя аргументами в конец программы
+	void emit(Instruction instruction, int arg, int arg2);
+
 	// Запись инструкции без аргументов по указанному адресу
 	void emitAt(int address, Instruction instruction);
 
@@ -103,12 +422,96 @@ public:
 	// Формирование "пустой" инструкции (NOP) и возврат ее адреса
 	int reserve();
 
-	// Запись последовательности инструкций в выходной поток
+	// Последняя инструкция программы (в потоковом режиме она еще не напечатана)
+	Command lastCommand() const
+	{
+		return commandBuffer_.at(commandBuffer_.size() - 1);
+	}
+
+	// Число исправлений уже записанных инструкций: вызовов emitAt() и переходов,
+	// адрес которых заполнен при привязке метки
+	size_t patchCount() const
+	{
+		return patches_;
+	}
+
+	// Наибольшее число инструкций, одновременно хранившихся в буфере
+	size_t peakSize() const
+	{
+		return max(peakSize_, static_cast<size_t>(commandBuffer_.size() - commandBuffer_.firstAddress()));
+	}
+
+	// Создание новой метки, еще не привязанной к адресу. Возвращает номер метки.
+	int newLabel();
+
+	// Привязка метки к адресу, непосредственно следующему за последней инструкцией
+	void bindLabel(int label);
+
+	// Метка больше не используется: в потоковом режиме ее номер будет выдан
+	// повторно. Все переходы на метку к этому моменту должны быть записаны.
+	void freeLabel(int label);
+
+	// Добавление в конец программы инструкции перехода на метку
+	//     Instruction instruction - JUMP, JUMP_YES или JUMP_NO
+	//     int label - номер метки, полученный от newLabel()
+	void emitJump(Instruction instruction, int label);
+
+	// То же для перехода со вторым аргументом (FOR_ENTRY, FOR_LOOP)
+	void emitJump(Instruction instruction, int label, int arg2);
+
+	// Вычисление адресов всех переходов на метки
+	void resolveLabels();
+
+	// Добавление в конец программы всей программы другого кодогенератора.
+	// Адреса переходов сдвигаются на текущий адрес, адреса переменных
+	// заменяются по таблице dataAddresses (старый адрес - индекс).
+	void append(CodeGen& other, const vector<int>& dataAddresses);
+
+	// Вся программа с вычисленными адресами переходов (не в потоковом режиме)
+	vector<Command> program();
+
+	// Замена всей программы, например оптимизированной (src/optimizer.cpp).
+	// Переходы в program должны содержать окончательные адреса.
+	void setProgram(const vector<Command>& program);
+
+	// Запись последовательности инструкций в выходной поток (в потоковом
+	// режиме - еще не напечатанных инструкций)
 	void flush();
 
+	// То же, что flush(), но текст инструкций формируется в отдельном потоке
+	// блоками по FORMAT_BLOCK инструкций, а этот поток только записывает готовые
+	// блоки в выходной поток
+	void flushPipelined();
+
 private:
+	// Метка: адрес, к которому она привязана (-1, если еще не привязана),
+	// и адрес последнего перехода в цепочке ожидающих переходов (-1, если цепочка пуста)
+	struct Label
+	{
+		int address;
+		int chain;
+		int oldest;   // Адрес первого ожидающего перехода (потоковый режим)
+	};
+
+	static const int FORMAT_BLOCK = 4096;
+	static const int STREAM_BLOCK = 4096;  // Как часто пытаться печатать готовые инструкции
+
+	// Заполнение цепочки ожидающих переходов на привязанную метку
+	void resolveLabel(Label& label);
+
+	// Печать окончательных инструкций и освобождение их сегментов (потоковый режим)
+	void stream();
+
 	ostream& output_;               // Выходной поток
-	vector<Command> commandBuffer_;	// Буфер инструкций
+	CommandBuffer commandBuffer_;   // Буфер инструкций
+	pmr::vector<Label> labels_;     // Таблица меток
+	bool streaming_;                // Потоковый режим
+	int written_;                   // Количество уже напечатанных инструкций
+	int nextStream_;                // Размер программы, при котором вызвать stream()
+	pmr::vector<int> openLabels_;   // Непривязанные метки с ожидающими переходами (потоковый режим)
+	pmr::vector<int> freeLabels_;   // Освобожденные метки (потоковый режим)
+	size_t patches_;                // Счетчик для patchCount()
+	size_t peakSize_;               // Наибольший размер буфера до освобождения сегментов
 };
 
 
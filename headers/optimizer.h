@@ -0,0 +1,211 @@
+#ifndef CMILAN_OPTIMIZER_H
+#define CMILAN_OPTIMIZER_H
+
+#include "codegen.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Оптимизатор готовой программы виртуальной машины (CompileOptions::optimize).
+//
+// Работает с программой после вычисления адресов переходов (CodeGen::program()).
+// Программа делится на базовые блоки: блок начинается с адреса перехода или
+// с инструкции после перехода или STOP; каждый переход таблицы TABLESWITCH -
+// отдельный блок, и проходы не удаляют их из таблицы. Проходы заменяют
+// инструкции или превращают их в NOP, а новые инструкции записывают в
+// inserted_; compact() удаляет NOP, вставляет новые инструкции и пересчитывает
+// адреса переходов.
+//
+// Проходы по порядку: условное распространение констант, упрощение умножения
+// и деления на константы, удаление мертвых
+// записей в переменные (по живости переменных), нумерация значений в блоках,
+// вынос инвариантов из циклов, упрощение переходов, удаление недостижимых
+// блоков, совмещение переменных в памяти данных.
+//
+// Если программу нельзя проанализировать (SHORT_AND/SHORT_OR, переход за пределы
+// программы, разная глубина стека на входе блока из разных мест - например,
+// оператор read в теле цикла), run() возвращает false и программа не меняется.
+
+class Optimizer
+{
+public:
+	explicit Optimizer(vector<Command>& program)
+		: code_(program), slotsBefore_(0), slotsAfter_(0)
+	{}
+
+	// Выполнение всех проходов; false, если программа не изменялась
+	bool run();
+
+	// Слов памяти данных до и после run()
+	int slotsBefore() const
+	{
+		return slotsBefore_;
+	}
+
+	int slotsAfter() const
+	{
+		return slotsAfter_;
+	}
+
+private:
+	// Базовый блок: инструкции [first, end)
+	struct Block
+	{
+		int first;
+		int end;
+		int successors[2];  // Номера блоков-преемников (-1 - нет)
+	};
+
+	// Значение на стеке при анализе. producer - адрес инструкции без побочных
+	// эффектов, которая положила значение (PUSH, LOAD, DUP или операция над
+	// такими значениями), - ее можно удалить вместе с потребителем значения;
+	// -1, если такой инструкции нет в текущем блоке.
+	struct Value
+	{
+		bool known;
+		int value;
+		int producer;
+	};
+
+	// Вычисление в нумерации значений: операция и номера значений операндов
+	struct ValueKey
+	{
+		int instruction;
+		int arg;
+		int left;
+		int right;
+
+		bool operator==(const ValueKey& other) const
+		{
+			return instruction == other.instruction && arg == other.arg &&
+				left == other.left && right == other.right;
+		}
+	};
+
+	struct ValueKeyHash
+	{
+		size_t operator()(const ValueKey& key) const
+		{
+			size_t h = key.instruction;
+			h = h * 1000003 + static_cast<unsigned>(key.arg);
+			h = h * 1000003 + static_cast<unsigned>(key.left);
+			return h * 1000003 + static_cast<unsigned>(key.right);
+		}
+	};
+
+	// Значение на стеке в нумерации значений; producer - как в Value,
+	// cost - сколько инструкций удалится вместе с producer
+	struct Numbered
+	{
+		int number;
+		int producer;
+		int cost;
+	};
+
+	// Значение на стеке при выносе из цикла: вычислено инструкциями
+	// [first, last] без побочных эффектов (cost - сколько их) и не меняется в цикле
+	struct Operand
+	{
+		bool invariant;
+		int first;
+		int last;
+		int cost;
+	};
+
+	// Состояние на входе блока при распространении констант
+	struct State
+	{
+		bool reached;                         // Блок достижим
+		vector<pair<int, int> > constants;    // Переменные с известными значениями, по возрастанию адреса
+		vector<Value> stack;                  // Стек машины
+	};
+
+	// Проходы run() по порядку; false, если очередное разбиение на блоки
+	// не удалось (тогда run() возвращает исходную программу)
+	bool runPasses();
+
+	// Разбиение на базовые блоки; false, если программу нельзя анализировать
+	bool buildGraph();
+
+	// Условное распространение констант: значения переменных и стека вычисляются
+	// только по путям, которые могут выполниться; условные переходы с известным
+	// условием становятся безусловными или удаляются, вычисления над константами
+	// заменяются результатом, недостижимые блоки удаляются.
+	bool propagateConstants();
+
+	// Выполнение инструкции над состоянием. Для условного перехода снятое со стека
+	// условие записывается в condition. При rewrite инструкции с известным
+	// результатом заменяются. false при нехватке значений на стеке.
+	bool evaluate(int address, State& state, Value* condition, bool rewrite);
+
+	// Объединение состояния from с входным состоянием блока; true, если оно изменилось
+	bool merge(State& into, const State& from);
+
+	// Удаление инструкции, положившей значение на стек, вместе с инструкциями,
+	// вычислившими ее операнды (operands_)
+	void remove(int address);
+
+	// Умножение и деление на константу заменяются более дешевыми инструкциями:
+	// на 1 - удаляются, на -1 - INVERT, умножение на степень двойки - SHL;
+	// деление неотрицательного значения на степень двойки - SHR, на другую
+	// положительную константу - MULHI и SHR. true, если что-то изменилось
+	bool reduceStrength();
+
+	// Живые переменные на входе и выходе каждого блока (liveIn_, liveOut_).
+	// false, если в программе есть BLOAD/BSTORE или таблицы слишком велики.
+	bool computeLiveness();
+
+	// Мертвые STORE (значение больше не читается ни на одном пути) заменяются
+	// на POP; true, если что-то изменилось
+	bool eliminateDeadStores();
+
+	// Нумерация значений в пределах блока: повторное вычисление уже известного
+	// значения заменяется на LOAD переменной, в которой оно записано, на DUP,
+	// если оно лежит на стеке прямо под новым, или (для выражений не короче
+	// MIN_SCRATCH_COST инструкций) на LOAD временной переменной, в которую
+	// значение копируется после первого вычисления. true, если что-то изменилось
+	bool numberValues();
+
+	// Вынос из естественных циклов выражений над переменными, в которые цикл
+	// не пишет: выражение вычисляется один раз перед заголовком цикла и
+	// записывается в новую переменную. Деление выносится только на ненулевую
+	// константу. true, если что-то изменилось
+	bool hoistInvariants();
+
+	// Переходы на безусловный переход ведут сразу в его цель, переходы на
+	// следующую инструкцию удаляются, JUMP на STOP заменяется на STOP
+	void simplifyJumps();
+
+	// Удаление блоков, в которые нельзя попасть из начала программы
+	void removeUnreachable();
+
+	// Переменные, которые никогда не живы одновременно, получают одно слово
+	// памяти: граф пересечений по живости раскрашивается жадно, аргументы
+	// LOAD/STORE заменяются номерами цветов
+	void allocateSlots();
+
+	// Удаление NOP и пересчет адресов переходов
+	void compact();
+
+	static const size_t MAX_LIVENESS_WORDS = 1 << 22; // Предел размера таблиц живости (слов по 64 бита)
+	static const int MAX_SLOT_VARIABLES = 8192;       // Больше переменных - матрица пересечений не строится
+	static const int MIN_SCRATCH_COST = 4;            // Короче - временная переменная не окупает DUP и STORE
+	static const size_t MAX_LOOP_WORK = 1 << 22;      // Предел суммарного размера тел циклов (в блоках)
+
+	vector<Command>& code_;   // Программа
+	vector<Block> blocks_;    // Базовые блоки в порядке адресов
+	vector<int> blockOf_;     // Номер блока для каждого адреса
+	bool failed_;             // Анализ невозможен (разная глубина стека)
+	vector<pair<int, int> > operands_; // Адреса инструкций, вычисливших операнды удаляемой операции
+	vector<pair<int, Command> > inserted_; // Инструкции, которые compact() вставит после указанного адреса
+	int variables_;           // Слов памяти данных в таблицах живости
+	size_t words_;            // Слов на множество переменных в таблицах живости
+	vector<uint64_t> liveIn_; // Живые переменные на входе блоков (по words_ слов на блок)
+	vector<uint64_t> liveOut_; // Живые переменные на выходе блоков
+	int slotsBefore_;         // Для slotsBefore()
+	int slotsAfter_;          // Для slotsAfter()
+};
+
+#endif
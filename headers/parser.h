@@ -2,20 +2,73 @@
 #define CMILAN_PARSER_H
 
 #include "scanner.h"
+#include "tablescanner.h"
+#include "tokenbuffer.h"
+#include "pipelinescanner.h"
 #include "codegen.h"
+#include "stats.h"
+#include "optimizer.h"
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <string>
 #include <map>
+#include <memory_resource>
 #include <stack>
+#include <string_view>
 
 using namespace std;
 
 
+// Параметры трансляции
+struct CompileOptions {
+    bool tableScanner;  // Использовать таблично-управляемый лексический анализатор (TableScanner)
+    bool ll1Parser;     // Разбирать программу по LL(1)-таблице (parseLL1) вместо рекурсивного спуска
+    bool tokenBuffer;   // Прочитать все лексемы в TokenBuffer до начала разбора
+    bool parallelLexing; // Разбить текст на лексемы параллельно (TokenBuffer по частям текста)
+    unsigned threads;   // Число потоков для параллельной работы (0 - по числу процессоров)
+    bool pipeline;      // Лексический анализ и вывод программы в отдельных потоках (PipelineScanner, flushPipelined)
+    bool parallelCompile; // Разбирать операторы верхнего уровня в нескольких потоках (нужен tokenBuffer)
+    bool streamOutput;  // Печатать окончательные инструкции по мере генерации (потоковый режим CodeGen);
+                        // при ошибке в программе ее начало уже напечатано
+    bool optimize;      // Оптимизировать программу перед выводом (Optimizer); отключает потоковый режим
+    pmr::memory_resource* memory; // Откуда арена трансляции берет блоки памяти (NULL - new/delete)
+    bool stats;         // Собирать статистику трансляции (Parser::stats())
+    ostream* output;    // Поток для программы (NULL - cout)
+
+    CompileOptions()
+            : tableScanner(false), ll1Parser(false), tokenBuffer(false), parallelLexing(false), threads(0),
+              pipeline(false), parallelCompile(false), streamOutput(false), optimize(false), memory(NULL), stats(false), output(NULL)
+    {}
+};
+
 struct LoopContext {
-    int conditionAddress;  // Адрес начала проверки условия
-    int exitAddress;       // Адрес для выхода из цикла (для break)
-    vector<int> breakAddresses; // List of addresses that need to be filled with the actual exit address
+    int conditionLabel;  // Метка начала проверки условия (для continue)
+    int exitLabel;       // Метка выхода из цикла (для break)
+};
+
+// Оператор case: код вариантов идет подряд, код выбора варианта - после них
+struct CaseContext {
+    int dispatchLabel;   // Метка кода выбора варианта
+    int exitLabel;       // Метка выхода из case
+    int elseLabel;       // Метка ветви else (-1 - ее нет)
+    size_t firstArm;     // Номер первого варианта этого case в caseArms_
+};
+
+// Вариант оператора case: значение метки и метка кода варианта
+struct CaseArm {
+    int value;
+    int label;
+};
+
+// Операция в стеке разбора выражения.
+// Открывающая скобка хранится в стеке как операция T_LPAREN.
+struct ExprOperator {
+    Token token;     // Лексема операции
+    int value;       // Arithmetic для T_ADDOP/T_MULOP, Cmp для T_CMP
+    int precedence;  // Приоритет операции
+    int label;       // Метка конца правого операнда для "&&" и "||"
+    bool prefix;     // Унарная (префиксная) операция
 };
 
 class Parser
@@ -24,53 +77,200 @@ public:
     // Конструктор
     //    const string& fileName - имя файла с программой для анализа
     //
+    //    istream& input - поток с текстом программы
+    //    const CompileOptions& options - параметры трансляции
+    //
     // Конструктор создает экземпляры лексического анализатора и генератора.
+    // Если задан options.tokenBuffer, весь текст разбивается на лексемы сразу,
+    // и разбор идет по индексу в TokenBuffer. При options.parallelLexing текст
+    // читается в память целиком и разбивается на лексемы в нескольких потоках.
+    //
+    // Все состояние трансляции (анализаторы, кодогенератор с программой, таблица
+    // переменных, стеки разбора) размещается в арене arena_ и освобождается
+    // вместе с ней целиком. Арена берет память блоками из options.memory.
 
-    Parser(const string& fileName, istream& input)
-            : output_(cout), error_(false), recovered_(true), lastVar_(0)
+    Parser(const string& fileName, istream& input, const CompileOptions& options = CompileOptions())
+            : started_(chrono::steady_clock::now()),
+              memory_(options.memory ? options.memory : pmr::new_delete_resource()), arena_(ARENA_BLOCK, &memory_),
+              collectStats_(options.stats), scanner_(NULL), sourceScanner_(NULL), tokens_(NULL), tokenIndex_(0), tokenEnd_(0), ownsTokens_(true),
+              output_(options.output ? *options.output : cout), error_(false), recovered_(true), reportErrors_(true),
+              variables_(&arena_),
+              lastVar_(0), loopStack_(&arena_), exprStack_(&arena_), exprCondition_(false),
+              ll1Parser_(options.ll1Parser), pipeline_(options.pipeline),
+              parallelCompile_(options.parallelCompile), threads_(options.threads), optimize_(options.optimize),
+              llStack_(&arena_), semStack_(&arena_), caseStack_(&arena_), caseArms_(&arena_)
     {
-        scanner_ = new Scanner(fileName, input);
-        codegen_ = new CodeGen(output_);
-        next();
+        codegen_ = create<CodeGen>(output_, options.streamOutput && !options.optimize, &arena_);
+
+        if(options.parallelLexing) {
+            string text((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+            tokens_ = create<TokenBuffer>(text, options.threads);
+            tokenEnd_ = tokens_->size() - 1;
+            stats_.lexSeconds = secondsSince(started_);
+            return;
+        }
+
+        if(options.tableScanner) {
+            scanner_ = create<TableScanner>(fileName, input);
+        }
+        else {
+            scanner_ = create<Scanner>(fileName, input);
+        }
+
+        if(options.tokenBuffer) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            tokens_ = create<TokenBuffer>(*scanner_);
+            tokenEnd_ = tokens_->size() - 1;
+            stats_.lexSeconds = secondsSince(start);
+        }
+        else {
+            if(options.pipeline) {
+                sourceScanner_ = scanner_;
+                scanner_ = create<PipelineScanner>(sourceScanner_);
+            }
+            next();
+        }
     }
 
     ~Parser()
     {
-        delete codegen_;
-        delete scanner_;
+        destroy(codegen_);
+        if(ownsTokens_) {
+            destroy(tokens_);
+        }
+        destroy(scanner_);
+        destroy(sourceScanner_);
     }
 
+    // Трансляция программы: compile(), затем, если ошибок нет, writeProgram()
     void parse();
 
+    // Синтаксический анализ и генерация кода без вывода программы
+    void compile();
+
+    // Вывод сгенерированной программы (после compile() без ошибок)
+    void writeProgram();
+
+    // В программе найдены ошибки (программа не выведена)
+    bool hasErrors() const
+    {
+        return error_;
+    }
+
+    // Статистика трансляции; заполняется в compile() и writeProgram(), если задан CompileOptions::stats
+    const CompileStats& stats() const
+    {
+        return stats_;
+    }
+
 private:
-    typedef map<string, int> VarTable;
+    // Анализатор части операторов верхнего уровня (src/parallelparser.cpp): лексемы
+    // [first, last] из общего буфера, last - ';' или END после последнего оператора.
+    // Ошибки не печатаются.
+    Parser(const TokenBuffer* tokens, size_t first, size_t last);
+
+    // Параллельный разбор списка операторов верхнего уровня по частям. Возвращает
+    // false, если программа не делится на части или в какой-либо части есть ошибка;
+    // тогда состояние анализатора не меняется.
+    bool compileParallel();
+    void optimize(); //оптимизация готовой программы (Optimizer)
+    void updateStats(); //заполнение счетчиков stats_ по состоянию анализатора
+    bool parseSlice(); //разбор операторов части до лексемы tokenEnd_ - 1
+
+    typedef pmr::map<pmr::string, int, less<> > VarTable;
+
+    static const size_t ARENA_BLOCK = 1 << 16; // Размер первого блока арены
+    static const int CASE_TABLE_SPREAD = 3;    // Таблица переходов, если диапазон меток case не больше их числа, умноженного на это
+    static const int MAX_CASE_TABLE = 1 << 16; // Наибольший диапазон меток для таблицы переходов
+    static const size_t CASE_LINEAR_ARMS = 3;  // Столько вариантов и меньше при поиске выбора проверяются по одному
+
+    // Создание объекта в арене
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        return new(arena_.allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    }
+
+    // Уничтожение объекта, созданного create(); память вернется при освобождении арены
+    template<typename T>
+    void destroy(T* object)
+    {
+        if(object) {
+            object->~T();
+        }
+    }
+
     void program();
     void statementList();
     void statement();
-    void expression();
-    void term();
+    bool expression();
     void factor();
     void relation();
 
+    // Цикл for: проверка явного шага, код после начального значения, предела
+    // и шага (начало тела) и после тела. forBegin() возвращает метку начала тела для forEnd().
+    void forStep();
+    int forBegin(int varAddress);
+    void forEnd(int varAddress, int bodyLabel);
 
+    // Оператор case: после выражения-селектора, в начале варианта с меткой value,
+    // в конце варианта, в начале ветви else и после esac. caseEnd() генерирует
+    // выбор варианта: TABLESWITCH для плотных меток, иначе двоичный поиск
+    void caseBegin();
+    void caseLabel(int value);
+    void caseArmEnd();
+    void caseElse();
+    void caseEnd();
+    void caseStatements(); //операторы варианта: до метки следующего варианта, else или esac
+    void caseSearch(size_t first, size_t last, int selector, int defaultLabel); //двоичный поиск по caseArms_[first, last)
 
+    void reduceExpression(size_t base, int precedence); //свертка операций из стека выражения
+    void applyOperator(const ExprOperator& op); //генерация кода для операции из стека выражения
 
+    // Разбор по LL(1)-таблице из milan_ll1.h (src/llparser.cpp): явный стек символов
+    // грамматики вместо рекурсии, код генерируют семантические действия.
+    void parseLL1();
+    void llAction(int action); //выполнение семантического действия
 
-    // Новые функции
-    void booleanExpression(); // Разбор логического выражения (OR, |)
-    void booleanTerm();       // Разбор логического терма (AND, &)
-    void booleanFactor();     // Разбор логического фактора (NOT, true, false, условие)
-
+    // Текущая лексема и ее значения: из TokenBuffer, если он есть, иначе из анализатора.
+    // Лексемы буфера после tokenEnd_ читаются как T_EOF.
+    Token token() const
+    {
+        if(tokens_) {
+            return tokenIndex_ < tokenEnd_ ? tokens_->token(tokenIndex_) : T_EOF;
+        }
+        return scanner_->token();
+    }
 
+    int intValue() const
+    {
+        return tokens_ ? tokens_->intValue(tokenIndex_) : scanner_->getIntValue();
+    }
 
+    const string& stringValue() const
+    {
+        return tokens_ ? tokens_->stringValue(tokenIndex_) : scanner_->getStringValue();
+    }
 
+    Cmp cmpValue() const
+    {
+        return tokens_ ? tokens_->cmpValue(tokenIndex_) : scanner_->getCmpValue();
+    }
 
+    Arithmetic arithmeticValue() const
+    {
+        return tokens_ ? tokens_->arithmeticValue(tokenIndex_) : scanner_->getArithmeticValue();
+    }
 
+    int lineNumber() const
+    {
+        return tokens_ ? tokens_->lineNumber(tokenIndex_) : scanner_->getLineNumber();
+    }
 
     // Сравнение текущей лексемы с образцом. Текущая позиция в потоке лексем не изменяется.
     bool see(Token t)
     {
-        return scanner_->token() == t;
+        return token() == t;
     }
 
     // Проверка совпадения текущей лексемы с образцом. Если лексема и образец совпадают,
@@ -78,8 +278,8 @@ private:
 
     bool match(Token t)
     {
-        if(scanner_->token() == t) {
-            scanner_->nextToken();
+        if(token() == t) {
+            next();
             return true;
         }
         else {
@@ -87,17 +287,32 @@ private:
         }
     }
 
-    // Переход к следующей лексеме.
+    // Переход к следующей лексеме. Лексема tokenEnd_ буфера (T_EOF) повторяется.
 
     void next()
     {
-        scanner_->nextToken();
+        if(tokens_) {
+            if(tokenIndex_ < tokenEnd_) {
+                ++tokenIndex_;
+            }
+        }
+        else if(collectStats_) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            scanner_->nextToken();
+            stats_.lexSeconds += secondsSince(start);
+            ++stats_.tokens;
+        }
+        else {
+            scanner_->nextToken();
+        }
     }
 
     // Обработчик ошибок.
     void reportError(const string& message)
     {
-        cerr << "Line " << scanner_->getLineNumber() << ": " << message << endl;
+        if(reportErrors_) {
+            cerr << "Line " << lineNumber() << ": " << message << endl;
+        }
         error_ = true;
     }
 
@@ -105,17 +320,40 @@ private:
     //Иначе создаем сообщение об ошибке и пробуем восстановиться
     void recover(Token t); //восстановление после ошибки: идем по коду до тех пор,
     //пока не встретим эту лексему или лексему конца файла.
-    int findOrAddVariable(const string&); //функция пробегает по variables_.
+    void mustBeWord(const char* word); //то же для незарезервированного слова (идентификатора с именем word)
+    int findOrAddVariable(string_view); //функция пробегает по variables_.
     //Если находит нужную переменную - возвращает ее номер, иначе добавляет ее в массив, увеличивает lastVar и возвращает его.
 
+    chrono::steady_clock::time_point started_; //время создания анализатора
+    CountingResource memory_; //источник блоков арены со счетчиком
+    pmr::monotonic_buffer_resource arena_; //арена трансляции (объявлена раньше данных в ней: освобождается последней)
+    bool collectStats_; //собирать статистику в stats_
+    CompileStats stats_; //статистика трансляции
     Scanner* scanner_; //лексический анализатор для конструктора
+    Scanner* sourceScanner_; //анализатор, читающий текст для PipelineScanner (NULL без --pipeline)
+    const TokenBuffer* tokens_; //заранее прочитанные лексемы (NULL, если лексемы читаются по одной)
+    size_t tokenIndex_; //номер текущей лексемы в tokens_
+    size_t tokenEnd_; //номер лексемы tokens_, дальше которой разбор не идет
+    bool ownsTokens_; //tokens_ удаляется вместе с анализатором
     CodeGen* codegen_; //указатель на виртуальную машину
-    ostream& output_; //выходной поток (в данном случае используем cout)
+    ostream& output_; //выходной поток (по умолчанию cout)
     bool error_; //флаг ошибки. Используется чтобы определить, выводим ли список команд после разбора или нет
     bool recovered_; //не используется
+    bool reportErrors_; //печатать сообщения об ошибках
     VarTable variables_; //массив переменных, найденных в программе
     int lastVar_; //номер последней записанной переменной
-    stack<LoopContext> loopStack_; // Стек для хранения информации о вложенных циклах
+    stack<LoopContext, pmr::vector<LoopContext> > loopStack_; // Стек для хранения информации о вложенных циклах
+    pmr::vector<ExprOperator> exprStack_; // Стек операций для разбора выражений
+    bool exprCondition_; // Результат последней свернутой операции - условие (сравнение или логическая операция)
+    bool ll1Parser_; // Разбор по LL(1)-таблице
+    bool pipeline_; // Вывод программы через flushPipelined()
+    bool parallelCompile_; // Разбор операторов верхнего уровня по частям в нескольких потоках
+    unsigned threads_; // Число потоков (0 - по числу процессоров)
+    bool optimize_; // Оптимизировать программу после разбора
+    pmr::vector<int> llStack_; // Стек символов грамматики при разборе по LL(1)-таблице
+    pmr::vector<int> semStack_; // Стек значений семантических действий (метки, переменные, операции)
+    stack<CaseContext, pmr::vector<CaseContext> > caseStack_; // Стек вложенных операторов case
+    pmr::vector<CaseArm> caseArms_; // Варианты открытых операторов case (вложенные - после внешних)
 };
 
 #endif
\ No newline at end of file
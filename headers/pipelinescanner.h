@@ -0,0 +1,54 @@
+#ifndef CMILAN_PIPELINESCANNER_H
+#define CMILAN_PIPELINESCANNER_H
+
+#include "scanner.h"
+#include "spscring.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Лексический анализатор, работающий в отдельном потоке.
+//
+// Поток-писатель вызывает nextToken() исходного анализатора и передает лексемы
+// пакетами через кольцевой буфер SpscRing; nextToken() этого анализатора берет
+// лексемы из буфера. Так разбор и генерация кода идут одновременно с
+// лексическим анализом.
+
+class PipelineScanner : public Scanner
+{
+public:
+	// Анализатор source должен существовать, пока существует PipelineScanner
+	explicit PipelineScanner(Scanner* source);
+
+	virtual ~PipelineScanner();
+
+	// Переход к следующей лексеме
+	virtual void nextToken();
+
+private:
+	// Лексема вместе со значениями, которые нужны синтаксическому анализатору
+	struct TokenRecord {
+		Token token;
+		int value;      // Число, Cmp или Arithmetic - в зависимости от token
+		int line;       // Номер строки
+		size_t offset;  // Смещение начала лексемы
+		string name;    // Имя переменной для T_IDENTIFIER
+	};
+
+	typedef vector<TokenRecord> TokenBatch;
+
+	static const size_t BATCH_SIZE = 256;   // Лексем в пакете
+	static const size_t RING_SIZE = 64;     // Пакетов в буфере
+
+	void produce(); //цикл потока-писателя
+
+	Scanner* source_; //исходный анализатор
+	SpscRing<TokenBatch> ring_;
+	TokenBatch batch_; //текущий пакет читателя
+	size_t position_; //номер текущей лексемы в batch_
+	thread producer_;
+};
+
+#endif
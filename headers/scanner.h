@@ -1,9 +1,11 @@
 #ifndef CMILAN_SCANNER_H
 #define CMILAN_SCANNER_H
 
+#include <array>
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -39,7 +41,11 @@ enum Token {
     T_BITOR,        // "|" (    побитовое ИЛИ)
     T_AND,          // "&&" (логическое И с коротким замыканием)
     T_OR,           // "||" (логическое ИЛИ с коротким замыканием)
-    T_NOT           // "!" (логическое отрицание)
+    T_NOT,          // "!" (логическое отрицание)
+    T_FOR,          // Ключевое слово "for"
+    T_CASE,         // Ключевое слово "case"
+    T_ESAC,         // Ключевое слово "esac"
+    T_COLON         // ":" (после метки варианта case)
 };
 
 // Функция tokenToString возвращает описание лексемы.
@@ -64,6 +70,34 @@ enum Arithmetic {
 	A_DIVIDE	//операция "/"
 };
 
+// Классы символов (битовые флаги). Таблица классов не зависит от локали,
+// в отличие от isdigit/isalpha.
+enum CharClass {
+	CC_LETTER = 1,	// Латинская буква
+	CC_DIGIT = 2	// Десятичная цифра
+};
+
+constexpr array<unsigned char, 256> makeCharClasses()
+{
+	array<unsigned char, 256> classes = {};
+	for(int c = 'a'; c <= 'z'; ++c) {
+		classes[c] |= CC_LETTER;
+		classes[c - 'a' + 'A'] |= CC_LETTER;
+	}
+	for(int c = '0'; c <= '9'; ++c) {
+		classes[c] |= CC_DIGIT;
+	}
+	return classes;
+}
+
+// Класс каждого из 256 значений байта
+inline constexpr array<unsigned char, 256> charClasses = makeCharClasses();
+
+inline unsigned char charClass(char c)
+{
+	return charClasses[static_cast<unsigned char>(c)];
+}
+
 
 
 
@@ -78,29 +112,8 @@ public:
         // из которого будут читаться символы транслируемой программы.
 
 	explicit Scanner(const string& fileName, istream& input)
-		: fileName_(fileName), lineNumber_(1), input_(input)
-	{
-
-		keywords_["begin"] = T_BEGIN;
-		keywords_["end"] = T_END;
-		keywords_["if"] = T_IF;
-		keywords_["then"] = T_THEN;
-		keywords_["else"] = T_ELSE;
-		keywords_["fi"] = T_FI;
-		keywords_["while"] = T_WHILE;
-		keywords_["do"] = T_DO;
-		keywords_["od"] = T_OD;
-		keywords_["write"] = T_WRITE;
-		keywords_["read"] = T_READ;
-
-        keywords_["break"] = T_BREAK;
-        keywords_["continue"] = T_CONTINUE;
-        // ADDED true and false keywoard
-        keywords_["true"] = T_TRUE;
-        keywords_["false"] = T_FALSE;
-
-        nextChar();
-	}
+		: Scanner(fileName, input, true)
+	{}
 
 	// Деструктор
 	virtual ~Scanner()
@@ -116,6 +129,12 @@ public:
 	{
 		return lineNumber_;
 	}
+
+	// Смещение начала текущей лексемы от начала текста
+	size_t getTokenOffset() const
+	{
+		return tokenOffset_;
+	}
 	
 	Token token() const
 	{
@@ -127,7 +146,7 @@ public:
 		return intValue_;
 	}
 	
-	string getStringValue() const
+	const string& getStringValue() const
 	{
 		return stringValue_;
 	}
@@ -144,43 +163,80 @@ public:
 
 	// Переход к следующей лексеме.
 	// Текущая лексема записывается в token_ и изымается из потока.
-	void nextToken();	
-private:
+	virtual void nextToken();
+
+protected:
+	// Конструктор для производных анализаторов, которые читают входной поток сами.
+	// Если primeInput == false, первый символ из потока не читается.
+	Scanner(const string& fileName, istream& input, bool primeInput)
+		: fileName_(fileName), lineNumber_(1), tokenOffset_(0), input_(input),
+		  position_(0), bufferSize_(0), bufferOffset_(0), eof_(false)
+	{
+        if(primeInput) {
+            nextChar();
+        }
+	}
+
+
+
+	// Пустой поток для производных анализаторов, которые не читают istream
+	static istream& noInput();
 
 	// Пропуск всех пробельные символы. 
 	// Если встречается символ перевода строки, номер текущей строки
 	// (lineNumber) увеличивается на единицу.
 	void skipSpace();
 
+	// Пропуск символов до первого символа c (он становится текущим) или до конца
+	// потока. Переводы строк в пропущенном тексте учитываются в lineNumber_.
+	void skipUntil(char c);
 
  	void nextChar(); //переходит к следующему символу
+	void fillBuffer(); //читает следующий блок входного потока в buffer_
 	//проверка переменной на первый символ (должен быть буквой латинского алфавита)
 	bool isIdentifierStart(char c)
 	{
-		return ((c >= 'a' && c <= 'z') ||
-			    (c >= 'A' && c <= 'Z'));
+		return (charClass(c) & CC_LETTER) != 0;
 	}
 	//проверка на остальные символы переменной (буква или цифра)
 	bool isIdentifierBody(char c)
 	{
-		return isIdentifierStart(c) || isdigit(c);
+		return (charClass(c) & (CC_LETTER | CC_DIGIT)) != 0;
 	}
 
 
 	const string fileName_; //входной файл
 	int lineNumber_; //номер текущей строки кода
 	
+	size_t tokenOffset_; //смещение начала текущей лексемы
 	Token token_; //текущая лексема
 	int intValue_; //значение текущего целого
 	string stringValue_; //имя переменной
 	Cmp cmpValue_; //значение оператора сравнения (>, <, =, !=, >=, <=)
 	Arithmetic arithmeticValue_; //значение знака (+,-,*,/)
 
-	map<string, Token> keywords_; //ассоциативный массив с лексемами и 
-	//соответствующими им зарезервированными словами в качестве индексов
+	// Ассоциативный массив с лексемами и соответствующими им зарезервированными
+	// словами в качестве индексов. Общий для всех анализаторов, строится один раз.
+	static const map<string, Token>& keywords();
+
+	// Лексема для слова stringValue_: ключевое слово или T_IDENTIFIER
+	Token keywordOrIdentifier() const
+	{
+		map<string, Token>::const_iterator kwd = keywords().find(stringValue_);
+		return kwd == keywords().end() ? T_IDENTIFIER : kwd->second;
+	}
 
 	istream& input_; //входной поток для чтения из файла.
 	char ch_; //текущий символ
+
+	// Входной поток читается блоками по BUFFER_SIZE байт, чтобы пробелы и
+	// комментарии можно было пропускать векторным поиском (textscan.h)
+	static const size_t BUFFER_SIZE = 65536;
+	vector<char> buffer_; //текущий блок входного потока
+	size_t position_; //позиция текущего символа ch_ в buffer_
+	size_t bufferSize_; //количество прочитанных в buffer_ байт
+	size_t bufferOffset_; //смещение buffer_[0] от начала текста
+	bool eof_; //входной поток исчерпан
 };
 
 #endif
@@ -0,0 +1,101 @@
+#ifndef CMILAN_SPSCRING_H
+#define CMILAN_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Кольцевой буфер без блокировок для одного писателя и одного читателя.
+//
+// Писатель меняет только tail_, читатель - только head_; каждая сторона хранит
+// копию чужого индекса и перечитывает его, лишь когда буфер кажется полным
+// (пустым). Ожидание - активное, с уступкой процессора (this_thread::yield).
+// Писатель завершает поток элементов вызовом close(); читатель может
+// прекратить чтение вызовом cancel(), после чего push() больше не ждет.
+
+template<typename T>
+class SpscRing
+{
+public:
+	// capacity округляется вверх до степени двойки
+	explicit SpscRing(size_t capacity)
+		: head_(0), cachedTail_(0), tail_(0), cachedHead_(0), closed_(false), cancelled_(false)
+	{
+		size_t size = 1;
+		while(size < capacity) {
+			size <<= 1;
+		}
+		slots_.resize(size);
+		mask_ = size - 1;
+	}
+
+	// Добавление элемента (писатель). Возвращает false, если читатель вызвал cancel().
+	bool push(T&& value)
+	{
+		size_t tail = tail_.load(memory_order_relaxed);
+		while(tail - cachedHead_ == slots_.size()) {
+			if(cancelled_.load(memory_order_relaxed)) {
+				return false;
+			}
+			cachedHead_ = head_.load(memory_order_acquire);
+			if(tail - cachedHead_ == slots_.size()) {
+				this_thread::yield();
+			}
+		}
+		slots_[tail & mask_] = move(value);
+		tail_.store(tail + 1, memory_order_release);
+		return true;
+	}
+
+	// Извлечение элемента (читатель). Возвращает false, если элементов больше не будет.
+	bool pop(T& value)
+	{
+		size_t head = head_.load(memory_order_relaxed);
+		while(head == cachedTail_) {
+			cachedTail_ = tail_.load(memory_order_acquire);
+			if(head != cachedTail_) {
+				break;
+			}
+			if(closed_.load(memory_order_acquire)) {
+				// close() вызван после последнего push(): перечитываем tail_
+				cachedTail_ = tail_.load(memory_order_acquire);
+				if(head == cachedTail_) {
+					return false;
+				}
+				break;
+			}
+			this_thread::yield();
+		}
+		value = move(slots_[head & mask_]);
+		head_.store(head + 1, memory_order_release);
+		return true;
+	}
+
+	// Писатель: элементов больше не будет
+	void close()
+	{
+		closed_.store(true, memory_order_release);
+	}
+
+	// Читатель: элементы больше не нужны
+	void cancel()
+	{
+		cancelled_.store(true, memory_order_relaxed);
+	}
+
+private:
+	vector<T> slots_;
+	size_t mask_;
+
+	alignas(64) atomic<size_t> head_;   // Следующий элемент для чтения
+	size_t cachedTail_;                 // Копия tail_ у читателя
+	alignas(64) atomic<size_t> tail_;   // Следующее свободное место для записи
+	size_t cachedHead_;                 // Копия head_ у писателя
+	alignas(64) atomic<bool> closed_;
+	atomic<bool> cancelled_;
+};
+
+#endif
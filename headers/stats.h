@@ -0,0 +1,93 @@
+#ifndef CMILAN_STATS_H
+#define CMILAN_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory_resource>
+
+using namespace std;
+
+// Статистика одной трансляции (CompileOptions::stats, Parser::stats()).
+//
+// Время лексического анализа при чтении лексем по одной измеряется вокруг
+// каждого вызова nextToken() и вычитается из времени разбора. При --emit=stream
+// большая часть вывода программы приходится на время разбора.
+
+struct CompileStats
+{
+	double lexSeconds;      // Лексический анализ
+	double parseSeconds;    // Синтаксический анализ и генерация кода
+	double flushSeconds;    // Вывод программы (CodeGen::flush)
+	double optimizeSeconds; // Оптимизация (CompileOptions::optimize)
+	double totalSeconds;    // От создания анализатора до конца вывода
+
+	size_t tokens;          // Прочитано лексем
+	size_t identifiers;     // Различных имен переменных
+	size_t instructions;    // Сгенерировано инструкций
+	size_t backpatches;     // Исправлений уже записанных инструкций (emitAt и заполнение переходов)
+	size_t peakInstructions; // Наибольшее число инструкций в буфере кодогенератора
+	size_t arenaBlocks;     // Блоков памяти, взятых ареной трансляции
+	size_t arenaBytes;      // Байт в этих блоках
+	size_t removedInstructions; // Инструкций удалено оптимизатором
+	size_t slotsBefore;     // Слов памяти данных для переменных до оптимизации
+	size_t slotsAfter;      // и после совмещения переменных с непересекающимся временем жизни
+
+	CompileStats()
+		: lexSeconds(0), parseSeconds(0), flushSeconds(0), optimizeSeconds(0), totalSeconds(0), tokens(0), identifiers(0),
+		  instructions(0), backpatches(0), peakInstructions(0), arenaBlocks(0), arenaBytes(0),
+		  removedInstructions(0), slotsBefore(0), slotsAfter(0)
+	{}
+
+	// Печать статистики одним объектом JSON
+	void printJson(ostream& os) const;
+};
+
+// Время в секундах, прошедшее с момента start
+inline double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Источник памяти, который передает запросы в upstream и считает выделенные блоки
+class CountingResource : public pmr::memory_resource
+{
+public:
+	explicit CountingResource(pmr::memory_resource* upstream)
+		: upstream_(upstream), blocks_(0), bytes_(0)
+	{}
+
+	size_t blocks() const
+	{
+		return blocks_;
+	}
+
+	size_t bytes() const
+	{
+		return bytes_;
+	}
+
+private:
+	virtual void* do_allocate(size_t bytes, size_t alignment)
+	{
+		++blocks_;
+		bytes_ += bytes;
+		return upstream_->allocate(bytes, alignment);
+	}
+
+	virtual void do_deallocate(void* p, size_t bytes, size_t alignment)
+	{
+		upstream_->deallocate(p, bytes, alignment);
+	}
+
+	virtual bool do_is_equal(const pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	pmr::memory_resource* upstream_;
+	size_t blocks_;
+	size_t bytes_;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CMILAN_TABLESCANNER_H
+#define CMILAN_TABLESCANNER_H
+
+#include "scanner.h"
+#include <string>
+
+using namespace std;
+
+// Таблично-управляемый лексический анализатор.
+//
+// Лексемы распознаются минимальным ДКА, который генератор milan_lexgen строит
+// по спецификации grammar/milan.lex при сборке. Внутренний цикл только переходит
+// по таблице milanDfaNext и запоминает последнее допускающее состояние; действие
+// (вид лексемы, значение, пропуск) берется из таблицы правил.
+// Входной поток читается в память целиком при создании анализатора.
+
+class TableScanner : public Scanner
+{
+public:
+	TableScanner(const string& fileName, istream& input);
+
+	// Анализатор текста, уже находящегося в памяти: лексемы читаются с позиции start.
+	// Текст не копируется и должен существовать, пока используется анализатор.
+	// Смещения лексем отсчитываются от начала text, номера строк - от позиции start.
+	TableScanner(const string& fileName, const string& text, size_t start);
+
+	// Переход к следующей лексеме
+	virtual void nextToken();
+
+private:
+	string storage_;               // Текст программы, прочитанный из потока
+	const unsigned char* text_;    // Начало текста
+	const unsigned char* pos_;     // Начало следующей лексемы
+	const unsigned char* end_;     // Конец текста
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef CMILAN_TEXTSCAN_H
+#define CMILAN_TEXTSCAN_H
+
+#include <cstddef>
+
+// Векторный поиск по блоку текста для лексического анализатора.
+// На x86 используются инструкции SSE2 и, если процессор их поддерживает, AVX2
+// (выбор делается один раз при первом вызове); на остальных платформах -
+// скалярная реализация. Все функции просматривают ровно n байт, начиная с p.
+
+// Возвращает длину начального отрезка из пробельных символов (как isspace в
+// локали "C": ' ', '\t', '\n', '\v', '\f', '\r'). Количество символов '\n'
+// в этом отрезке прибавляется к newlines.
+size_t scanWhitespace(const char* p, size_t n, int& newlines);
+
+// Возвращает позицию первого символа c или n, если его нет.
+// Количество символов '\n' перед найденной позицией прибавляется к newlines.
+size_t scanUntil(const char* p, size_t n, char c, int& newlines);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CMILAN_TOKENBUFFER_H
+#define CMILAN_TOKENBUFFER_H
+
+#include "scanner.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Поток лексем, полностью прочитанный заранее.
+//
+// Лексемы хранятся в параллельных массивах (структура массивов): вид лексемы,
+// значение и смещение начала лексемы в тексте. Значение зависит от вида:
+// число для T_NUMBER, Cmp для T_CMP, Arithmetic для T_ADDOP/T_MULOP и номер имени
+// в таблице names_ для T_IDENTIFIER. Одинаковые имена хранятся один раз.
+// Номера строк хранятся отрезками: lineTokens_[k] - номер первой лексемы,
+// начиная с которой действует номер строки lineNumbers_[k].
+// Последняя лексема буфера всегда T_EOF.
+//
+// Большой текст можно разбить на лексемы параллельно: текст делится на части по
+// границам строк, каждая часть разбирается в своем потоке (таблично-управляемым
+// анализатором), затем массивы частей склеиваются. Часть может начинаться внутри
+// комментария /* */; тогда ее лексемы до первой общей с настоящим разбором позиции
+// отбрасываются и разбираются заново. Номера строк частей сдвигаются на число
+// переводов строки перед частью (префиксные суммы). Результат совпадает с
+// последовательным разбором.
+
+class TokenBuffer
+{
+public:
+	// Читает лексемы из анализатора до конца текста
+	explicit TokenBuffer(Scanner& scanner);
+
+	// Разбивает текст на лексемы в threads потоках (0 - по числу процессоров).
+	// Тексты короче MIN_CHUNK_SIZE на поток разбиваются на меньшее число частей.
+	TokenBuffer(const string& text, unsigned threads);
+
+	size_t size() const
+	{
+		return kinds_.size();
+	}
+
+	Token token(size_t i) const
+	{
+		return static_cast<Token>(kinds_[i]);
+	}
+
+	int intValue(size_t i) const
+	{
+		return payloads_[i];
+	}
+
+	const string& stringValue(size_t i) const
+	{
+		return names_[payloads_[i]];
+	}
+
+	Cmp cmpValue(size_t i) const
+	{
+		return static_cast<Cmp>(payloads_[i]);
+	}
+
+	Arithmetic arithmeticValue(size_t i) const
+	{
+		return static_cast<Arithmetic>(payloads_[i]);
+	}
+
+	size_t offset(size_t i) const
+	{
+		return offsets_[i];
+	}
+
+	int lineNumber(size_t i) const; //номер строки после чтения лексемы i (как Scanner::getLineNumber)
+
+private:
+	static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	struct Chunk;
+
+	TokenBuffer()
+	{}
+
+	void push(const Scanner& scanner); //добавление текущей лексемы анализатора
+	int intern(const string& name); //номер имени в names_ (новое имя добавляется)
+	void addLine(int line); //номер строки для следующей добавляемой лексемы
+	//добавление лексем [first, last) из другого буфера; номера строк увеличиваются на lineShift
+	void append(const TokenBuffer& from, size_t first, size_t last, int lineShift);
+	size_t find(size_t offset) const; //номер лексемы, начинающейся в offset, или size()
+	void merge(const vector<Chunk*>& parts); //склейка разобранных частей текста
+
+	//разбор части текста с позиции chunk.start (см. tokenbuffer.cpp)
+	static void lexChunk(const string& text, Chunk& chunk, const Chunk* speculative);
+
+	vector<uint8_t> kinds_; //вид лексемы (Token)
+	vector<int32_t> payloads_; //значение лексемы
+	vector<uint32_t> offsets_; //смещение начала лексемы в тексте
+
+	vector<uint32_t> lineTokens_; //номер первой лексемы отрезка с одинаковым номером строки
+	vector<int> lineNumbers_; //номер строки для отрезка
+
+	vector<string> names_; //различные имена переменных
+	unordered_map<string, int> nameIndex_; //номер имени в names_
+};
+
+#endif
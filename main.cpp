@@ -1,32 +1,117 @@
 #include "headers/parser.h"
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 
 using namespace std;
 
 void printHelp()
 {
-    cout << "Usage: cmilan input_file" << endl;
+    cout << "Usage: cmilan [options] input_file" << endl;
+    cout << "Options:" << endl;
+    cout << "  --scanner=hand    hand-written lexical analyzer (default)" << endl;
+    cout << "  --scanner=table   table-driven DFA lexical analyzer" << endl;
+    cout << "  --parser=rd       recursive descent parser (default)" << endl;
+    cout << "  --parser=ll1      table-driven LL(1) parser" << endl;
+    cout << "  --tokens=stream   read tokens one at a time while parsing (default)" << endl;
+    cout << "  --tokens=buffer   split the whole file into tokens before parsing" << endl;
+    cout << "  --tokens=parallel split the file into tokens on several threads before parsing" << endl;
+    cout << "  --threads=N       number of threads for parallel work (default: number of CPUs)" << endl;
+    cout << "  --pipeline        run lexing, parsing and output formatting on separate threads" << endl;
+    cout << "  --compile=serial  parse the top-level statements one after another (default)" << endl;
+    cout << "  --compile=parallel parse slices of the top-level statements on several threads" << endl;
+    cout << "  --emit=buffer     print the program after the whole file is compiled (default)" << endl;
+    cout << "  --emit=stream     print instructions as soon as their jump targets are known;" << endl;
+    cout << "                    memory depends on nesting depth, not on program length" << endl;
+    cout << "  --optimize        optimize the program before printing it: constant propagation," << endl;
+    cout << "                    dead code removal, reuse of repeated expressions, hoisting of" << endl;
+    cout << "                    loop invariants, sharing of variable slots (disables --emit=stream)" << endl;
+    cout << "  --stats           print phase times and counters as JSON to stderr" << endl;
 }
 
 int main(int argc, char** argv)
 {
-    if(argc < 2) {
+    CompileOptions options;
+    const char* fileName = NULL;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--scanner=hand") == 0) {
+            options.tableScanner = false;
+        }
+        else if(strcmp(argv[i], "--scanner=table") == 0) {
+            options.tableScanner = true;
+        }
+        else if(strcmp(argv[i], "--parser=rd") == 0) {
+            options.ll1Parser = false;
+        }
+        else if(strcmp(argv[i], "--parser=ll1") == 0) {
+            options.ll1Parser = true;
+        }
+        else if(strcmp(argv[i], "--tokens=stream") == 0) {
+            options.tokenBuffer = false;
+            options.parallelLexing = false;
+        }
+        else if(strcmp(argv[i], "--tokens=buffer") == 0) {
+            options.tokenBuffer = true;
+        }
+        else if(strcmp(argv[i], "--tokens=parallel") == 0) {
+            options.tokenBuffer = true;
+            options.parallelLexing = true;
+        }
+        else if(strcmp(argv[i], "--compile=serial") == 0) {
+            options.parallelCompile = false;
+        }
+        else if(strcmp(argv[i], "--compile=parallel") == 0) {
+            options.tokenBuffer = true;
+            options.parallelCompile = true;
+        }
+        else if(strcmp(argv[i], "--emit=buffer") == 0) {
+            options.streamOutput = false;
+        }
+        else if(strcmp(argv[i], "--emit=stream") == 0) {
+            options.streamOutput = true;
+        }
+        else if(strcmp(argv[i], "--optimize") == 0) {
+            options.optimize = true;
+        }
+        else if(strcmp(argv[i], "--stats") == 0) {
+            options.stats = true;
+        }
+        else if(strcmp(argv[i], "--pipeline") == 0) {
+            options.pipeline = true;
+        }
+        else if(strncmp(argv[i], "--threads=", 10) == 0) {
+            options.threads = static_cast<unsigned>(atoi(argv[i] + 10));
+        }
+        else if(argv[i][0] == '-' && argv[i][1] == '-') {
+            cerr << "Unknown option '" << argv[i] << "'" << endl;
+            printHelp();
+            return EXIT_FAILURE;
+        }
+        else {
+            fileName = argv[i];
+        }
+    }
+
+    if(fileName == NULL) {
         printHelp();
         return EXIT_FAILURE;
     }
 
     ifstream input;
-    input.open(argv[1]);
+    input.open(fileName);
 
     if(input) {
-        Parser p(argv[1], input);
+        Parser p(fileName, input, options);
         p.parse();
+        if(options.stats) {
+            p.stats().printJson(cerr);
+        }
         return EXIT_SUCCESS;
     }
     else {
-        cerr << "File '" << argv[1] << "' not found" << endl;
+        cerr << "File '" << fileName << "' not found" << endl;
         return EXIT_FAILURE;
     }
-}
\ No newline at end of file
+}
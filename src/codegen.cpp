@@ -1,157 +1,277 @@
 #include "../headers/codegen.h"
+#include "../headers/spscring.h"
+#include <algorithm>
+#include <sstream>
+#include <thread>
 
-void Command::print(int address, ostream& os)
+const char* instructionName(Instruction instruction)
 {
-    os << address << ":\t";
-    switch(instruction_) {
-        case NOP:
-            os << "NOP";
-            break;
-
-        case STOP:
-            os << "STOP";
-            break;
-
-        case LOAD:
-            os << "LOAD\t" << arg_;
-            break;
-
-        case STORE:
-            os << "STORE\t" << arg_;
-            break;
-
-        case BLOAD:
-            os << "BLOAD\t" << arg_;
-            break;
-
-        case BSTORE:
-            os << "BSTORE\t" << arg_;
-            break;
-
-        case PUSH:
-            os << "PUSH\t" << arg_;
-            break;
-
-        case POP:
-            os << "POP";
-            break;
-
-        case DUP:
-            os << "DUP";
-            break;
-
-        case ADD:
-            os << "ADD";
-            break;
-
-        case SUB:
-            os << "SUB";
-            break;
-
-        case MULT:
-            os << "MULT";
-            break;
-
-        case DIV:
-            os << "DIV";
-            break;
+    switch(instruction) {
+        case NOP: return "NOP";
+        case STOP: return "STOP";
+        case LOAD: return "LOAD";
+        case STORE: return "STORE";
+        case BLOAD: return "BLOAD";
+        case BSTORE: return "BSTORE";
+        case PUSH: return "PUSH";
+        case POP: return "POP";
+        case DUP: return "DUP";
+        case ADD: return "ADD";
+        case SUB: return "SUB";
+        case MULT: return "MULT";
+        case DIV: return "DIV";
+        case INVERT: return "INVERT";
+        case COMPARE: return "COMPARE";
+        case JUMP: return "JUMP";
+        case JUMP_YES: return "JUMP_YES";
+        case JUMP_NO: return "JUMP_NO";
+        case INPUT: return "INPUT";
+        case PRINT: return "PRINT";
+        case BITAND: return "BITAND";
+        case BITOR: return "BITOR";
+        case NOT: return "NOT";
+        case PUSH_TRUE: return "PUSH_TRUE";
+        case PUSH_FALSE: return "PUSH_FALSE";
+        case SHORT_AND: return "SHORT_AND";
+        case SHORT_OR: return "SHORT_OR";
+        case SHL: return "SHL";
+        case SHR: return "SHR";
+        case MULHI: return "MULHI";
+        case FOR_ENTRY: return "FOR_ENTRY";
+        case FOR_LOOP: return "FOR_LOOP";
+        case TABLESWITCH: return "TABLESWITCH";
+    }
+    return "";
+}
 
-        case INVERT:
-            os << "INVERT";
-            break;
+void Command::print(int address, ostream& os)
+{
+    os << address << ":\t" << instructionName(instruction_);
+    if(hasArgument(instruction_)) {
+        os << "\t" << arg_;
+    }
+    if(hasSecondArgument(instruction_)) {
+        os << "\t" << arg2_;
+    }
+    os << endl;
+}
 
-        case COMPARE:
-            os << "COMPARE\t" << arg_;
-            break;
+void CodeGen::emit(Instruction instruction)
+{
+	emit(instruction, 0);
+}
 
-        case JUMP:
-            os << "JUMP\t" << arg_;
-            break;
+void CodeGen::emit(Instruction instruction, int arg)
+{
+	emit(instruction, arg, 0);
+}
 
-        case JUMP_YES:
-            os << "JUMP_YES\t" << arg_;
-            break;
+void CodeGen::emit(Instruction instruction, int arg, int arg2)
+{
+	commandBuffer_.push(instruction, arg, arg2);
+	if(streaming_ && commandBuffer_.size() >= nextStream_) {
+		stream();
+	}
+}
 
-        case JUMP_NO:
-            os << "JUMP_NO\t" << arg_;
-            break;
+void CodeGen::emitAt(int address, Instruction instruction)
+{
+	emitAt(address, instruction, 0);
+}
 
-        case INPUT:
-            os << "INPUT";
-            break;
+void CodeGen::emitAt(int address, Instruction instruction, int arg)
+{
+	commandBuffer_.set(address, instruction, arg);
+	++patches_;
+}
 
-        case PRINT:
-            os << "PRINT";
-            break;
+int CodeGen::getCurrentAddress()
+{
+	return commandBuffer_.size();
+}
 
-        case BITAND:
-            os << "BITAND";
-            break;
+int CodeGen::reserve()
+{
+	emit(NOP);
+	return commandBuffer_.size() - 1;
+}
 
-        case BITOR:
-            os << "BITOR";
-            break;
+int CodeGen::newLabel()
+{
+	Label label = { -1, -1, -1 };
+	if(streaming_ && !freeLabels_.empty()) {
+		int free = freeLabels_.back();
+		freeLabels_.pop_back();
+		labels_[free] = label;
+		return free;
+	}
+	labels_.push_back(label);
+	return labels_.size() - 1;
+}
 
-        case NOT:
-            os << "NOT";
-            break;
+void CodeGen::bindLabel(int label)
+{
+	labels_[label].address = getCurrentAddress();
+	if(streaming_) {
+		resolveLabel(labels_[label]);
+		pmr::vector<int>::iterator open = find(openLabels_.begin(), openLabels_.end(), label);
+		if(open != openLabels_.end()) {
+			*open = openLabels_.back();
+			openLabels_.pop_back();
+		}
+	}
+}
 
-        case PUSH_TRUE:
-            os << "PUSH_TRUE";
-            break;
+void CodeGen::freeLabel(int label)
+{
+	// Метка с ожидающими переходами (после ошибки в программе) не освобождается
+	if(streaming_ && labels_[label].chain < 0) {
+		freeLabels_.push_back(label);
+	}
+}
 
-        case PUSH_FALSE:
-            os << "PUSH_FALSE";
-            break;
-
-        case SHORT_AND:
-            os << "SHORT_AND\t" << arg_;
-            break;
+void CodeGen::emitJump(Instruction instruction, int label)
+{
+	emitJump(instruction, label, 0);
+}
 
-        case SHORT_OR:
-            os << "SHORT_OR\t" << arg_;
-            break;
-    }
+void CodeGen::emitJump(Instruction instruction, int label, int arg2)
+{
+	if(streaming_) {
+		if(labels_[label].address >= 0) {
+			emit(instruction, labels_[label].address, arg2);
+			return;
+		}
+		if(labels_[label].chain < 0) {
+			labels_[label].oldest = getCurrentAddress();
+			openLabels_.push_back(label);
+		}
+	}
 
-    os << endl;
+	// Аргумент перехода временно хранит ссылку на предыдущее звено цепочки
+	emit(instruction, labels_[label].chain, arg2);
+	labels_[label].chain = getCurrentAddress() - 1;
 }
 
-void CodeGen::emit(Instruction instruction)
+void CodeGen::resolveLabel(Label& label)
 {
-	commandBuffer_.push_back(Command(instruction));
+	int site = label.chain;
+	while(site >= 0) {
+		int next = commandBuffer_.arg(site);
+		commandBuffer_.set(site, commandBuffer_.instruction(site), label.address);
+		++patches_;
+		site = next;
+	}
+	label.chain = -1;
 }
 
-void CodeGen::emit(Instruction instruction, int arg)
+void CodeGen::resolveLabels()
 {
-	commandBuffer_.push_back(Command(instruction, arg));
+	for(Label& label : labels_) {
+		if(label.address >= 0) {
+			resolveLabel(label);
+		}
+	}
 }
 
-void CodeGen::emitAt(int address, Instruction instruction)
+void CodeGen::stream()
 {
-	commandBuffer_[address] = Command(instruction);
+	// Окончательны инструкции ниже первого ожидающего перехода, кроме последней
+	int limit = commandBuffer_.size() - 1;
+	for(int label : openLabels_) {
+		limit = min(limit, labels_[label].oldest);
+	}
+	for(; written_ < limit; ++written_) {
+		commandBuffer_.at(written_).print(written_, output_);
+	}
+	peakSize_ = peakSize();
+	commandBuffer_.release(written_);
+	nextStream_ = commandBuffer_.size() + STREAM_BLOCK;
 }
 
-void CodeGen::emitAt(int address, Instruction instruction, int arg)
+void CodeGen::append(CodeGen& other, const vector<int>& dataAddresses)
 {
-	commandBuffer_[address] = Command(instruction, arg);
+	other.resolveLabels();
+
+	int base = getCurrentAddress();
+	int count = other.commandBuffer_.size();
+	for(int address = 0; address < count; ++address) {
+		Instruction instruction = other.commandBuffer_.instruction(address);
+		int arg = other.commandBuffer_.arg(address);
+		int arg2 = other.commandBuffer_.arg2(address);
+		if(hasCodeAddress(instruction)) {
+			arg += base;
+		}
+		else if(hasDataAddress(instruction)) {
+			arg = dataAddresses[arg];
+		}
+		if(hasSecondDataAddress(instruction)) {
+			arg2 = dataAddresses[arg2];
+		}
+		emit(instruction, arg, arg2);
+	}
 }
 
-int CodeGen::getCurrentAddress()
+vector<Command> CodeGen::program()
 {
-	return commandBuffer_.size();
+	resolveLabels();
+
+	vector<Command> result;
+	int count = commandBuffer_.size();
+	result.reserve(count);
+	for(int address = 0; address < count; ++address) {
+		result.push_back(commandBuffer_.at(address));
+	}
+	return result;
 }
 
-int CodeGen::reserve()
+void CodeGen::setProgram(const vector<Command>& program)
 {
-	emit(NOP);
-	return commandBuffer_.size() - 1;
+	commandBuffer_.clear();
+	labels_.clear();
+	for(const Command& command : program) {
+		commandBuffer_.push(command.instruction(), command.arg(), command.arg2());
+	}
 }
 
 void CodeGen::flush()
 {
+	resolveLabels();
+
 	int count = commandBuffer_.size();
-	for(int address = 0; address < count; ++address) {
-		commandBuffer_[address].print(address, output_);
+	for(int address = written_; address < count; ++address) {
+		commandBuffer_.at(address).print(address, output_);
+	}
+	written_ = count;
+	output_.flush();
+}
+
+void CodeGen::flushPipelined()
+{
+	resolveLabels();
+
+	int count = commandBuffer_.size();
+	SpscRing<string> blocks(16);
+	int start = written_;
+	thread formatter([this, &blocks, start, count] {
+		for(int first = start; first < count; first += FORMAT_BLOCK) {
+			ostringstream text;
+			int last = min(count, first + FORMAT_BLOCK);
+			for(int address = first; address < last; ++address) {
+				commandBuffer_.at(address).print(address, text);
+			}
+			if(!blocks.push(text.str())) {
+				return;
+			}
+		}
+		blocks.close();
+	});
+
+	string block;
+	while(blocks.pop(block)) {
+		output_.write(block.data(), block.size());
 	}
+	formatter.join();
+	written_ = count;
 	output_.flush();
 }
@@ -0,0 +1,317 @@
+#include "../headers/parser.h"
+#include "milan_ll1.h"
+
+// Номер столбца LL(1)-таблицы для лексемы
+static int llColumn(Token t)
+{
+    static const vector<int> columns = [] {
+        int size = 0;
+        for(Token terminal : milanLLTerminals) {
+            size = max(size, static_cast<int>(terminal) + 1);
+        }
+        vector<int> result(size, MILAN_LL_COLUMNS - 1);
+        for(int i = 0; i < MILAN_LL_COLUMNS - 1; ++i) {
+            result[milanLLTerminals[i]] = i;
+        }
+        return result;
+    }();
+
+    return static_cast<size_t>(t) < columns.size() ? columns[t] : MILAN_LL_COLUMNS - 1;
+}
+
+//Разбор программы по LL(1)-таблице. Символы грамматики хранятся в явном стеке llStack_:
+//терминал сравнивается с текущей лексемой (как в mustBe), нетерминал заменяется правой частью
+//правила из таблицы, семантическое действие генерирует код. Глубина вложенности конструкций
+//ограничена только памятью.
+void Parser::parseLL1()
+{
+    llStack_.clear();
+    semStack_.clear();
+    llStack_.push_back(MILAN_LL_START);
+
+    while(!llStack_.empty()) {
+        int symbol = llStack_.back();
+        llStack_.pop_back();
+
+        if(symbol < MILAN_LL_NONTERMINAL) {
+            mustBe(static_cast<Token>(symbol));
+        }
+        else if(symbol < MILAN_LL_ACTION) {
+            int nonterminal = symbol - MILAN_LL_NONTERMINAL;
+            int production = milanLLTable[nonterminal][llColumn(token())];
+            if(production == 0) {
+                // Нетерминал пропускается, разбор продолжается со следующего символа
+                reportError(milanLLErrors[nonterminal]);
+                continue;
+            }
+
+            const MilanLLProduction& rule = milanLLProductions[production];
+            llStack_.insert(llStack_.end(), milanLLRhs + rule.offset, milanLLRhs + rule.offset + rule.length);
+        }
+        else {
+            llAction(symbol);
+        }
+    }
+}
+
+void Parser::llAction(int action)
+{
+    switch(action) {
+        case LA_STOP:
+            codegen_->emit(STOP);
+            break;
+
+        case LA_ASSIGN_TARGET:
+            semStack_.push_back(findOrAddVariable(stringValue()));
+            break;
+
+        case LA_ASSIGN:
+            codegen_->emit(STORE, semStack_.back());
+            semStack_.pop_back();
+            break;
+
+        case LA_IF_COND: {
+            int elseLabel = codegen_->newLabel();
+            codegen_->emitJump(JUMP_NO, elseLabel);
+            semStack_.push_back(elseLabel);
+            break;
+        }
+
+        case LA_ELSE: {
+            int elseLabel = semStack_.back();
+            int endLabel = codegen_->newLabel();
+            codegen_->emitJump(JUMP, endLabel);
+            codegen_->bindLabel(elseLabel);
+            codegen_->freeLabel(elseLabel);
+            semStack_.back() = endLabel;
+            break;
+        }
+
+        case LA_IF_END:
+            codegen_->bindLabel(semStack_.back());
+            codegen_->freeLabel(semStack_.back());
+            semStack_.pop_back();
+            break;
+
+        case LA_WHILE_BEGIN: {
+            int conditionLabel = codegen_->newLabel();
+            codegen_->bindLabel(conditionLabel);
+            semStack_.push_back(conditionLabel);
+            semStack_.push_back(codegen_->getCurrentAddress());
+            semStack_.push_back(token());
+            break;
+        }
+
+        case LA_WHILE_COND: {
+            Token first = static_cast<Token>(semStack_.back());
+            semStack_.pop_back();
+            int start = semStack_.back();
+            semStack_.pop_back();
+
+            // Условие из одного слова true/false, как и в relation(), проверяется
+            // инструкцией PUSH_TRUE/PUSH_FALSE
+            if((first == T_TRUE || first == T_FALSE) && codegen_->getCurrentAddress() == start + 1) {
+                codegen_->emitAt(start, first == T_TRUE ? PUSH_TRUE : PUSH_FALSE);
+            }
+            else if(!exprCondition_) {
+                reportError("comparison operator expected.");
+            }
+
+            LoopContext context;
+            context.conditionLabel = semStack_.back();
+            context.exitLabel = codegen_->newLabel();
+            semStack_.pop_back();
+            codegen_->emitJump(JUMP_NO, context.exitLabel);
+            loopStack_.push(context);
+            break;
+        }
+
+        case LA_WHILE_END:
+            codegen_->emitJump(JUMP, loopStack_.top().conditionLabel);
+            codegen_->bindLabel(loopStack_.top().exitLabel);
+            codegen_->freeLabel(loopStack_.top().conditionLabel);
+            codegen_->freeLabel(loopStack_.top().exitLabel);
+            loopStack_.pop();
+            break;
+
+        case LA_FOR_TARGET:
+            semStack_.push_back(findOrAddVariable(stringValue()));
+            break;
+
+        case LA_FOR_INIT:
+            codegen_->emit(STORE, semStack_.back());
+            break;
+
+        case LA_FOR_TO:
+            mustBeWord("to");
+            break;
+
+        case LA_FOR_STEP:
+            mustBeWord("step");
+            break;
+
+        case LA_FOR_STEP_END:
+            forStep();
+            break;
+
+        case LA_CASE_OF:
+            mustBeWord("of");
+            caseBegin();
+            break;
+
+        case LA_CASE_SIGN:
+            if(arithmeticValue() != A_MINUS) {
+                reportError("case label expected.");
+            }
+            semStack_.push_back(arithmeticValue() == A_MINUS);
+            break;
+
+        case LA_CASE_LABEL:
+            caseLabel(intValue());
+            break;
+
+        case LA_CASE_SIGNED: {
+            bool negative = semStack_.back();
+            semStack_.pop_back();
+            caseLabel(negative ? -intValue() : intValue());
+            break;
+        }
+
+        case LA_CASE_ARM_END:
+            caseArmEnd();
+            break;
+
+        case LA_CASE_ELSE:
+            caseElse();
+            break;
+
+        case LA_CASE_END:
+            caseEnd();
+            break;
+
+        case LA_STEP_DEFAULT:
+            codegen_->emit(PUSH, 1);
+            break;
+
+        case LA_FOR_BEGIN:
+            semStack_.push_back(forBegin(semStack_.back()));
+            break;
+
+        case LA_FOR_END: {
+            int bodyLabel = semStack_.back();
+            semStack_.pop_back();
+            forEnd(semStack_.back(), bodyLabel);
+            semStack_.pop_back();
+            break;
+        }
+
+        case LA_WRITE:
+            codegen_->emit(PRINT);
+            break;
+
+        case LA_READ:
+        case LA_INPUT:
+            codegen_->emit(INPUT);
+            exprCondition_ = false;
+            break;
+
+        case LA_BREAK:
+            if(loopStack_.empty()) {
+                reportError("'break' statement outside of loop");
+            }
+            else {
+                codegen_->emitJump(JUMP, loopStack_.top().exitLabel);
+            }
+            break;
+
+        case LA_CONTINUE:
+            if(loopStack_.empty()) {
+                reportError("'continue' statement outside of loop");
+            }
+            else {
+                codegen_->emitJump(JUMP, loopStack_.top().conditionLabel);
+            }
+            break;
+
+        case LA_OR_BEGIN:
+        case LA_AND_BEGIN: {
+            int endLabel = codegen_->newLabel();
+            codegen_->emit(DUP);
+            codegen_->emitJump(action == LA_OR_BEGIN ? JUMP_YES : JUMP_NO, endLabel);
+            codegen_->emit(POP);
+            semStack_.push_back(endLabel);
+            break;
+        }
+
+        case LA_OR_END:
+        case LA_AND_END: {
+            ExprOperator op = { action == LA_OR_END ? T_OR : T_AND, 0, 0, semStack_.back(), false };
+            semStack_.pop_back();
+            applyOperator(op);
+            break;
+        }
+
+        case LA_BITOR:
+        case LA_BITAND: {
+            ExprOperator op = { action == LA_BITOR ? T_BITOR : T_BITAND, 0, 0, -1, false };
+            applyOperator(op);
+            break;
+        }
+
+        case LA_PUSH_CMP:
+            semStack_.push_back(cmpValue());
+            break;
+
+        case LA_PUSH_ARITH:
+            semStack_.push_back(arithmeticValue());
+            break;
+
+        case LA_CMP:
+        case LA_ARITH: {
+            int value = semStack_.back();
+            semStack_.pop_back();
+
+            Token token = T_CMP;
+            if(action == LA_ARITH) {
+                token = (value == A_PLUS || value == A_MINUS) ? T_ADDOP : T_MULOP;
+            }
+            ExprOperator op = { token, value, 0, -1, false };
+            applyOperator(op);
+            break;
+        }
+
+        case LA_MINUS:
+            if(arithmeticValue() != A_MINUS) {
+                reportError("expression expected.");
+            }
+            break;
+
+        case LA_INVERT: {
+            ExprOperator op = { T_ADDOP, A_MINUS, 0, -1, true };
+            applyOperator(op);
+            break;
+        }
+
+        case LA_NOT: {
+            ExprOperator op = { T_NOT, 0, 0, -1, true };
+            applyOperator(op);
+            break;
+        }
+
+        case LA_NUMBER:
+            codegen_->emit(PUSH, intValue());
+            exprCondition_ = false;
+            break;
+
+        case LA_LOAD:
+            codegen_->emit(LOAD, findOrAddVariable(stringValue()));
+            exprCondition_ = false;
+            break;
+
+        case LA_TRUE:
+        case LA_FALSE:
+            codegen_->emit(PUSH, action == LA_TRUE ? 1 : 0);
+            exprCondition_ = true;
+            break;
+    }
+}
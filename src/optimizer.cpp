@@ -0,0 +1,1552 @@
+#include "../headers/optimizer.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <queue>
+
+// Вычисление операции над константами так же, как ее выполняет виртуальная
+// машина: целые числа складываются и умножаются по модулю 2^32. Деление на
+// ноль не вычисляется - это ошибка времени выполнения.
+static bool fold(Instruction instruction, int arg, int a, int b, int& result)
+{
+	unsigned ua = static_cast<unsigned>(a);
+	unsigned ub = static_cast<unsigned>(b);
+	switch(instruction) {
+		case ADD: result = static_cast<int>(ua + ub); return true;
+		case SUB: result = static_cast<int>(ua - ub); return true;
+		case MULT: result = static_cast<int>(ua * ub); return true;
+		case DIV:
+			if(b == 0) {
+				return false;
+			}
+			result = b == -1 ? static_cast<int>(0u - ua) : a / b;
+			return true;
+		case BITAND: result = a & b; return true;
+		case BITOR: result = a | b; return true;
+		case INVERT: result = static_cast<int>(0u - ua); return true;
+		case NOT: result = a == 0; return true;
+		case SHL: result = static_cast<int>(ua << (arg & 31)); return true;
+		case SHR: result = a >> (arg & 31); return true;
+		case MULHI: result = static_cast<int>((static_cast<int64_t>(a) * arg) >> 32); return true;
+		case COMPARE:
+			switch(arg) {
+				case 0: result = a == b; return true;
+				case 1: result = a != b; return true;
+				case 2: result = a < b; return true;
+				case 3: result = a > b; return true;
+				case 4: result = a <= b; return true;
+				case 5: result = a >= b; return true;
+			}
+			return false;
+		default:
+			return false;
+	}
+}
+
+// Операция без побочных эффектов над одним значением на вершине стека
+static bool isUnary(Instruction instruction)
+{
+	return instruction == INVERT || instruction == NOT || instruction == SHL || instruction == SHR ||
+		instruction == MULHI;
+}
+
+// Множитель m (0 < m < 2^31) и сдвиг shift, для которых n / d равно
+// (n * m) >> (32 + shift) при любом 0 <= n < 2^31 (MULHI m; SHR shift).
+// n * m / 2^(32 + shift) = n / d + n * e / (d * 2^(32 + shift)), где
+// e = m * d - 2^(32 + shift), поэтому достаточно n * e < 2^(32 + shift).
+static bool divisionMagic(int d, int& m, int& shift)
+{
+	for(shift = 0; shift < 32; ++shift) {
+		uint64_t power = uint64_t(1) << (32 + shift);
+		uint64_t multiplier = (power + d - 1) / d;
+		if(multiplier >= (uint64_t(1) << 31)) {
+			return false;
+		}
+		if((multiplier * d - power) * INT_MAX < power) {
+			m = static_cast<int>(multiplier);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Показатель степени двойки, если value (как 32-битное без знака) - степень двойки, иначе -1
+static int powerOfTwo(int value)
+{
+	unsigned u = static_cast<unsigned>(value);
+	if(u == 0 || (u & (u - 1)) != 0) {
+		return -1;
+	}
+	int k = 0;
+	while((u >>= 1) != 0) {
+		++k;
+	}
+	return k;
+}
+
+// Значение переменной address среди известных констант
+static const int* findConstant(const vector<pair<int, int> >& constants, int address)
+{
+	vector<pair<int, int> >::const_iterator it =
+		lower_bound(constants.begin(), constants.end(), make_pair(address, INT_MIN));
+	return it != constants.end() && it->first == address ? &it->second : NULL;
+}
+
+// Число слов памяти данных, к которым обращается программа
+static int countSlots(const vector<Command>& code)
+{
+	int slots = 0;
+	for(const Command& command : code) {
+		if(hasDataAddress(command.instruction())) {
+			slots = max(slots, command.arg() + 1);
+		}
+		if(hasSecondDataAddress(command.instruction())) {
+			slots = max(slots, command.arg2() + 1);
+		}
+	}
+	return slots;
+}
+
+bool Optimizer::run()
+{
+	slotsBefore_ = countSlots(code_);
+	slotsAfter_ = slotsBefore_;
+	vector<Command> original(code_);
+	if(!runPasses()) {
+		code_.swap(original);
+		inserted_.clear();
+		slotsAfter_ = slotsBefore_;
+		return false;
+	}
+	return true;
+}
+
+bool Optimizer::runPasses()
+{
+	if(!buildGraph() || !propagateConstants()) {
+		return false;
+	}
+	compact();
+
+	if(!buildGraph()) {
+		return false;
+	}
+	if(reduceStrength()) {
+		compact();
+	}
+
+	// Удаление мертвых STORE оставляет на их месте POP, а повторное
+	// распространение констант удаляет POP вместе с вычислением значения
+	if(!buildGraph()) {
+		return false;
+	}
+	if(eliminateDeadStores()) {
+		if(!propagateConstants()) {
+			return false;
+		}
+		compact();
+	}
+
+	if(!buildGraph()) {
+		return false;
+	}
+	if(numberValues()) {
+		compact();
+	}
+	if(!buildGraph()) {
+		return false;
+	}
+	if(hoistInvariants()) {
+		compact();
+	}
+
+	if(!buildGraph()) {
+		return false;
+	}
+	simplifyJumps();
+	compact();
+	if(!buildGraph()) {
+		return false;
+	}
+	removeUnreachable();
+	compact();
+
+	if(!buildGraph()) {
+		return false;
+	}
+	allocateSlots();
+	return true;
+}
+
+bool Optimizer::buildGraph()
+{
+	int count = code_.size();
+	vector<char> leader(count + 1, false);
+	vector<char> chained(count, false);   // Переход таблицы TABLESWITCH, за которым идет следующий
+	leader[0] = true;
+	for(int address = 0; address < count; ++address) {
+		Instruction instruction = code_[address].instruction();
+		if(instruction == SHORT_AND || instruction == SHORT_OR) {
+			return false;
+		}
+		if(instruction == TABLESWITCH) {
+			// Каждый переход таблицы - отдельный блок
+			int size = code_[address].arg2();
+			if(size < 0 || address + size + 1 >= count) {
+				return false;
+			}
+			// Переход таблицы на STOP simplifyJumps заменяет самим STOP
+			for(int entry = address + 1; entry <= address + size + 1; ++entry) {
+				if(code_[entry].instruction() != JUMP && code_[entry].instruction() != STOP) {
+					return false;
+				}
+				leader[entry] = true;
+				chained[entry] = entry <= address + size;
+			}
+		}
+		if(hasCodeAddress(instruction)) {
+			int target = code_[address].arg();
+			if(target < 0 || target > count) {
+				return false;
+			}
+			leader[target] = true;
+			leader[address + 1] = true;
+		}
+		else if(instruction == STOP) {
+			leader[address + 1] = true;
+		}
+	}
+
+	blocks_.clear();
+	blockOf_.assign(count, -1);
+	for(int address = 0; address < count; ++address) {
+		if(leader[address]) {
+			if(!blocks_.empty()) {
+				blocks_.back().end = address;
+			}
+			Block block = { address, count, { -1, -1 } };
+			blocks_.push_back(block);
+		}
+		blockOf_[address] = blocks_.size() - 1;
+	}
+
+	// Переход на адрес count (конец программы) преемника не имеет. Блоки таблицы
+	// TABLESWITCH связаны в цепочку: так у блока остается не больше двух
+	// преемников, а анализ видит все пути (и несколько лишних)
+	for(Block& block : blocks_) {
+		const Command& last = code_[block.end - 1];
+		int next = block.end < count ? blockOf_[block.end] : -1;
+		int target = hasCodeAddress(last.instruction()) && last.arg() < count ? blockOf_[last.arg()] : -1;
+		switch(last.instruction()) {
+			case JUMP:
+				block.successors[0] = target;
+				break;
+			case JUMP_YES:
+			case JUMP_NO:
+			case FOR_ENTRY:
+			case FOR_LOOP:
+				block.successors[0] = next;
+				block.successors[1] = target;
+				break;
+			case STOP:
+				break;
+			default:
+				block.successors[0] = next;
+				break;
+		}
+		// В том числе для перехода таблицы, ставшего STOP
+		if(chained[block.end - 1]) {
+			block.successors[1] = next;
+		}
+	}
+	return true;
+}
+
+bool Optimizer::evaluate(int address, State& state, Value* condition, bool rewrite)
+{
+	Command& command = code_[address];
+	Instruction instruction = command.instruction();
+	vector<Value>& stack = state.stack;
+	Value unknown = { false, 0, -1 };
+
+	switch(instruction) {
+		case NOP:
+		case STOP:
+		case JUMP:
+			break;
+
+		case PUSH:
+		case PUSH_TRUE:
+		case PUSH_FALSE: {
+			Value v = { true, instruction == PUSH ? command.arg() : instruction == PUSH_TRUE, address };
+			stack.push_back(v);
+			break;
+		}
+
+		case LOAD: {
+			const int* constant = findConstant(state.constants, command.arg());
+			Value v = { constant != NULL, constant ? *constant : 0, address };
+			if(rewrite && constant) {
+				command = Command(PUSH, *constant);
+			}
+			stack.push_back(v);
+			break;
+		}
+
+		case DUP: {
+			if(stack.empty()) {
+				return false;
+			}
+			Value v = stack.back();
+			if(rewrite && v.known) {
+				command = Command(PUSH, v.value);
+			}
+			else {
+				// Копия читает значение под ней: его уже нельзя удалить
+				stack.back().producer = -1;
+			}
+			v.producer = address;
+			stack.push_back(v);
+			break;
+		}
+
+		case STORE: {
+			if(stack.empty()) {
+				return false;
+			}
+			Value v = stack.back();
+			stack.pop_back();
+			vector<pair<int, int> >& constants = state.constants;
+			vector<pair<int, int> >::iterator it =
+				lower_bound(constants.begin(), constants.end(), make_pair(command.arg(), INT_MIN));
+			bool present = it != constants.end() && it->first == command.arg();
+			if(v.known && present) {
+				it->second = v.value;
+			}
+			else if(v.known) {
+				constants.insert(it, make_pair(command.arg(), v.value));
+			}
+			else if(present) {
+				constants.erase(it);
+			}
+			break;
+		}
+
+		case POP: {
+			if(stack.empty()) {
+				return false;
+			}
+			Value v = stack.back();
+			stack.pop_back();
+			if(rewrite && v.producer >= 0) {
+				remove(v.producer);
+				command = Command(NOP);
+			}
+			break;
+		}
+
+		case ADD:
+		case SUB:
+		case MULT:
+		case DIV:
+		case BITAND:
+		case BITOR:
+		case COMPARE: {
+			if(stack.size() < 2) {
+				return false;
+			}
+			Value b = stack.back();
+			stack.pop_back();
+			Value a = stack.back();
+			stack.pop_back();
+			Value v = unknown;
+			if(a.known && b.known && fold(instruction, command.arg(), a.value, b.value, v.value)) {
+				v.known = true;
+				if(rewrite && a.producer >= 0 && b.producer >= 0) {
+					remove(a.producer);
+					remove(b.producer);
+					command = Command(PUSH, v.value);
+					v.producer = address;
+				}
+			}
+			else if(a.producer >= 0 && b.producer >= 0 && (instruction != DIV || (b.known && b.value != 0))) {
+				// Операция без побочных эффектов удаляется вместе с операндами
+				v.producer = address;
+				operands_[address] = make_pair(a.producer, b.producer);
+			}
+			stack.push_back(v);
+			break;
+		}
+
+		case INVERT:
+		case NOT:
+		case SHL:
+		case SHR:
+		case MULHI: {
+			if(stack.empty()) {
+				return false;
+			}
+			Value a = stack.back();
+			stack.pop_back();
+			Value v = unknown;
+			if(a.known && fold(instruction, command.arg(), a.value, 0, v.value)) {
+				v.known = true;
+				if(rewrite && a.producer >= 0) {
+					remove(a.producer);
+					command = Command(PUSH, v.value);
+					v.producer = address;
+				}
+			}
+			else if(a.producer >= 0) {
+				v.producer = address;
+				operands_[address] = make_pair(a.producer, -1);
+			}
+			stack.push_back(v);
+			break;
+		}
+
+		case JUMP_YES:
+		case JUMP_NO: {
+			if(stack.empty()) {
+				return false;
+			}
+			Value v = stack.back();
+			stack.pop_back();
+			*condition = v;
+			if(rewrite && v.known) {
+				bool taken = (v.value != 0) == (instruction == JUMP_YES);
+				if(v.producer >= 0) {
+					remove(v.producer);
+					command = taken ? Command(JUMP, command.arg()) : Command(NOP);
+				}
+				else if(!taken) {
+					command = Command(POP);
+				}
+				// Иначе переход выполняется всегда и снимает условие со стека сам
+			}
+			break;
+		}
+
+		case FOR_ENTRY:
+		case FOR_LOOP: {
+			// Шаг и предел остаются на стеке; FOR_LOOP делает переменную цикла неизвестной
+			if(stack.size() < 2) {
+				return false;
+			}
+			stack[stack.size() - 1].producer = -1;
+			stack[stack.size() - 2].producer = -1;
+			if(instruction == FOR_ENTRY) {
+				break;
+			}
+			vector<pair<int, int> >& constants = state.constants;
+			vector<pair<int, int> >::iterator it =
+				lower_bound(constants.begin(), constants.end(), make_pair(command.arg2(), INT_MIN));
+			if(it != constants.end() && it->first == command.arg2()) {
+				constants.erase(it);
+			}
+			break;
+		}
+
+		case INPUT:
+			stack.push_back(unknown);
+			break;
+
+		case PRINT:
+		case TABLESWITCH:
+			if(stack.empty()) {
+				return false;
+			}
+			stack.pop_back();
+			break;
+
+		case BLOAD:
+			if(stack.empty()) {
+				return false;
+			}
+			stack.back() = unknown;
+			break;
+
+		case BSTORE:
+			if(stack.size() < 2) {
+				return false;
+			}
+			stack.pop_back();
+			stack.pop_back();
+			state.constants.clear();
+			break;
+
+		default:
+			return false;
+	}
+	return true;
+}
+
+bool Optimizer::merge(State& into, const State& from)
+{
+	if(!into.reached) {
+		into = from;
+		into.reached = true;
+		return true;
+	}
+	if(into.stack.size() != from.stack.size()) {
+		failed_ = true;
+		return false;
+	}
+
+	bool changed = false;
+	for(size_t i = 0; i < into.stack.size(); ++i) {
+		Value& v = into.stack[i];
+		if(v.known && (!from.stack[i].known || from.stack[i].value != v.value)) {
+			v.known = false;
+			changed = true;
+		}
+	}
+
+	// Пересечение известных констант с одинаковыми значениями
+	vector<pair<int, int> >& constants = into.constants;
+	size_t kept = 0;
+	for(size_t i = 0; i < constants.size(); ++i) {
+		const int* other = findConstant(from.constants, constants[i].first);
+		if(other && *other == constants[i].second) {
+			constants[kept++] = constants[i];
+		}
+	}
+	if(kept != constants.size()) {
+		constants.resize(kept);
+		changed = true;
+	}
+	return changed;
+}
+
+bool Optimizer::propagateConstants()
+{
+	failed_ = false;
+	operands_.assign(code_.size(), make_pair(-1, -1));
+	vector<State> states(blocks_.size());
+	for(State& state : states) {
+		state.reached = false;
+	}
+	// Блоки обрабатываются по возрастанию адреса: так блок после if обычно
+	// получает состояния из обеих ветвей до того, как будет обработан
+	priority_queue<int, vector<int>, greater<int> > work;
+	vector<char> queued(blocks_.size(), false);
+
+	states[0].reached = true;
+	work.push(0);
+	queued[0] = true;
+	while(!work.empty()) {
+		int b = work.top();
+		work.pop();
+		queued[b] = false;
+
+		const Block& block = blocks_[b];
+		State state = states[b];
+		Value condition = { false, 0, -1 };
+		for(int address = block.first; address < block.end; ++address) {
+			if(!evaluate(address, state, &condition, false)) {
+				return false;
+			}
+		}
+
+		// Условный переход с известным условием ведет только в один блок
+		int successors[2] = { block.successors[0], block.successors[1] };
+		Instruction last = code_[block.end - 1].instruction();
+		if((last == JUMP_YES || last == JUMP_NO) && condition.known) {
+			bool taken = (condition.value != 0) == (last == JUMP_YES);
+			successors[taken ? 0 : 1] = -1;
+		}
+
+		for(int s : successors) {
+			if(s >= 0 && merge(states[s], state) && !queued[s]) {
+				work.push(s);
+				queued[s] = true;
+			}
+			if(failed_) {
+				return false;
+			}
+		}
+	}
+
+	// Замены по окончательным входным состояниям блоков
+	for(size_t b = 0; b < blocks_.size(); ++b) {
+		const Block& block = blocks_[b];
+		if(!states[b].reached) {
+			for(int address = block.first; address < block.end; ++address) {
+				code_[address] = Command(NOP);
+			}
+			continue;
+		}
+
+		State& state = states[b];
+		for(Value& v : state.stack) {
+			v.producer = -1;
+		}
+		Value condition = { false, 0, -1 };
+		for(int address = block.first; address < block.end; ++address) {
+			evaluate(address, state, &condition, true);
+		}
+	}
+	return true;
+}
+
+void Optimizer::remove(int address)
+{
+	vector<int> work(1, address);
+	while(!work.empty()) {
+		int a = work.back();
+		work.pop_back();
+		code_[a] = Command(NOP);
+		if(operands_[a].first >= 0) {
+			work.push_back(operands_[a].first);
+		}
+		if(operands_[a].second >= 0) {
+			work.push_back(operands_[a].second);
+		}
+	}
+}
+
+bool Optimizer::computeLiveness()
+{
+	for(const Command& command : code_) {
+		if(command.instruction() == BLOAD || command.instruction() == BSTORE) {
+			return false;
+		}
+	}
+	variables_ = countSlots(code_);
+	words_ = (variables_ + 63) / 64;
+	if(words_ * blocks_.size() > MAX_LIVENESS_WORDS) {
+		return false;
+	}
+
+	// use - переменные, читаемые в блоке до записи, def - записываемые
+	size_t total = words_ * blocks_.size();
+	vector<uint64_t> use(total, 0);
+	vector<uint64_t> def(total, 0);
+	liveIn_.assign(total, 0);
+	liveOut_.assign(total, 0);
+	for(size_t b = 0; b < blocks_.size(); ++b) {
+		uint64_t* u = use.data() + b * words_;
+		uint64_t* d = def.data() + b * words_;
+		for(int address = blocks_[b].first; address < blocks_[b].end; ++address) {
+			Instruction instruction = code_[address].instruction();
+			int v = hasSecondDataAddress(instruction) ? code_[address].arg2() : code_[address].arg();
+			if((instruction == LOAD || hasSecondDataAddress(instruction)) && !(d[v / 64] >> (v % 64) & 1)) {
+				u[v / 64] |= uint64_t(1) << (v % 64);
+			}
+			else if(instruction == STORE) {
+				d[v / 64] |= uint64_t(1) << (v % 64);
+			}
+		}
+	}
+
+	// После STOP и в конце программы живых переменных нет
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(size_t b = blocks_.size(); b-- > 0;) {
+			uint64_t* out = liveOut_.data() + b * words_;
+			for(int s : blocks_[b].successors) {
+				if(s >= 0) {
+					const uint64_t* in = liveIn_.data() + s * words_;
+					for(size_t w = 0; w < words_; ++w) {
+						out[w] |= in[w];
+					}
+				}
+			}
+			uint64_t* in = liveIn_.data() + b * words_;
+			for(size_t w = 0; w < words_; ++w) {
+				uint64_t value = use[b * words_ + w] | (out[w] & ~def[b * words_ + w]);
+				if(value != in[w]) {
+					in[w] = value;
+					changed = true;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool Optimizer::eliminateDeadStores()
+{
+	if(!computeLiveness()) {
+		return false;
+	}
+
+	bool changed = false;
+	vector<uint64_t> live(words_);
+	for(size_t b = 0; b < blocks_.size(); ++b) {
+		copy(liveOut_.begin() + b * words_, liveOut_.begin() + (b + 1) * words_, live.begin());
+		for(int address = blocks_[b].end; address-- > blocks_[b].first;) {
+			Instruction instruction = code_[address].instruction();
+			int v = hasSecondDataAddress(instruction) ? code_[address].arg2() : code_[address].arg();
+			if(instruction == LOAD || hasSecondDataAddress(instruction)) {
+				// FOR_LOOP читает переменную цикла до того, как записать
+				live[v / 64] |= uint64_t(1) << (v % 64);
+			}
+			else if(instruction == STORE) {
+				uint64_t bit = uint64_t(1) << (v % 64);
+				if(!(live[v / 64] & bit)) {
+					code_[address] = Command(POP);
+					changed = true;
+				}
+				live[v / 64] &= ~bit;
+			}
+		}
+	}
+	return changed;
+}
+
+void Optimizer::simplifyJumps()
+{
+	int count = code_.size();
+	int tableEnd = 0;   // Конец последней таблицы TABLESWITCH: ее переходы нельзя удалять
+	for(int address = 0; address < count; ++address) {
+		Instruction instruction = code_[address].instruction();
+		if(instruction == TABLESWITCH) {
+			tableEnd = address + code_[address].arg2() + 2;
+		}
+		if(instruction != JUMP && instruction != JUMP_YES && instruction != JUMP_NO) {
+			continue;
+		}
+
+		// Переход на безусловный переход ведет сразу в его цель (с защитой от циклов)
+		int target = code_[address].arg();
+		for(int step = 0; step < count && target < count && code_[target].instruction() == JUMP; ++step) {
+			target = code_[target].arg();
+		}
+
+		if(target == address + 1 && address >= tableEnd) {
+			code_[address] = Command(instruction == JUMP ? NOP : POP);
+		}
+		else if(instruction == JUMP && target < count && code_[target].instruction() == STOP) {
+			code_[address] = Command(STOP);
+		}
+		else {
+			code_[address] = Command(instruction, target);
+		}
+	}
+}
+
+void Optimizer::removeUnreachable()
+{
+	vector<char> reached(blocks_.size(), false);
+	vector<int> work(1, 0);
+	reached[0] = true;
+	while(!work.empty()) {
+		int b = work.back();
+		work.pop_back();
+		for(int s : blocks_[b].successors) {
+			if(s >= 0 && !reached[s]) {
+				reached[s] = true;
+				work.push_back(s);
+			}
+		}
+	}
+
+	for(size_t b = 0; b < blocks_.size(); ++b) {
+		if(!reached[b]) {
+			for(int address = blocks_[b].first; address < blocks_[b].end; ++address) {
+				code_[address] = Command(NOP);
+			}
+		}
+	}
+}
+
+void Optimizer::allocateSlots()
+{
+	if(!computeLiveness() || variables_ > MAX_SLOT_VARIABLES) {
+		return;
+	}
+
+	// Матрица пересечений: переменная, записанная STORE, пересекается со всеми
+	// переменными, живыми после записи. Сначала заполняется только строка
+	// записываемой переменной, симметричные биты ставятся в конце.
+	size_t n = variables_;
+	vector<uint64_t> interference(n * words_, 0);
+	vector<char> used(n, false);
+	vector<uint64_t> live(words_);
+	for(size_t b = 0; b < blocks_.size(); ++b) {
+		copy(liveOut_.begin() + b * words_, liveOut_.begin() + (b + 1) * words_, live.begin());
+		for(int address = blocks_[b].end; address-- > blocks_[b].first;) {
+			Instruction instruction = code_[address].instruction();
+			int v = hasSecondDataAddress(instruction) ? code_[address].arg2() : code_[address].arg();
+			if(instruction == STORE || instruction == FOR_LOOP) {
+				uint64_t* row = interference.data() + v * words_;
+				for(size_t w = 0; w < words_; ++w) {
+					row[w] |= live[w];
+				}
+				live[v / 64] &= ~(uint64_t(1) << (v % 64));
+				used[v] = true;
+			}
+			if(instruction == LOAD || hasSecondDataAddress(instruction)) {
+				live[v / 64] |= uint64_t(1) << (v % 64);
+				used[v] = true;
+			}
+		}
+	}
+
+	// Переменная, живая в начале программы, читает начальный ноль своего слова:
+	// его не должна менять ни одна другая переменная
+	for(size_t v = 0; v < n; ++v) {
+		if(liveIn_[v / 64] >> (v % 64) & 1) {
+			fill(interference.begin() + v * words_, interference.begin() + (v + 1) * words_, ~uint64_t(0));
+		}
+	}
+
+	for(size_t v = 0; v < n; ++v) {
+		for(size_t w = 0; w < words_; ++w) {
+			for(uint64_t bits = interference[v * words_ + w]; bits; bits &= bits - 1) {
+				size_t u = w * 64 + __builtin_ctzll(bits);
+				if(u < n) {
+					interference[u * words_ + v / 64] |= uint64_t(1) << (v % 64);
+				}
+			}
+		}
+	}
+
+	// Жадная раскраска в порядке номеров: наименьшее слово, не занятое соседями
+	vector<int> slot(n, -1);
+	vector<size_t> taken;
+	int slots = 0;
+	for(size_t v = 0; v < n; ++v) {
+		if(!used[v]) {
+			continue;
+		}
+		taken.assign(slots, n);
+		for(size_t w = 0; w < words_; ++w) {
+			for(uint64_t bits = interference[v * words_ + w]; bits; bits &= bits - 1) {
+				size_t u = w * 64 + __builtin_ctzll(bits);
+				if(u < n && u != v && slot[u] >= 0) {
+					taken[slot[u]] = v;
+				}
+			}
+		}
+		int s = 0;
+		while(s < slots && taken[s] == v) {
+			++s;
+		}
+		slot[v] = s;
+		slots = max(slots, s + 1);
+	}
+
+	for(Command& command : code_) {
+		if(command.instruction() == LOAD || command.instruction() == STORE) {
+			command = Command(command.instruction(), slot[command.arg()]);
+		}
+		else if(hasSecondDataAddress(command.instruction())) {
+			command = Command(command.instruction(), command.arg(), slot[command.arg2()]);
+		}
+	}
+	slotsAfter_ = slots;
+}
+
+bool Optimizer::reduceStrength()
+{
+	bool changed = false;
+	for(const Block& block : blocks_) {
+		// Для значения на стеке: адрес PUSH, который его положил (-1 - другая
+		// инструкция), и известно ли, что значение неотрицательно
+		vector<pair<int, bool> > stack;
+		pair<int, bool> unknown(-1, false);
+		auto pop = [&]() {
+			if(stack.empty()) {
+				return unknown;
+			}
+			pair<int, bool> e = stack.back();
+			stack.pop_back();
+			return e;
+		};
+
+		for(int address = block.first; address < block.end; ++address) {
+			Command& command = code_[address];
+			Instruction instruction = command.instruction();
+			switch(instruction) {
+				case NOP:
+					break;
+
+				case PUSH:
+					stack.push_back(make_pair(address, command.arg() >= 0));
+					break;
+
+				case PUSH_TRUE:
+				case PUSH_FALSE:
+					stack.push_back(make_pair(-1, true));
+					break;
+
+				case DUP: {
+					pair<int, bool> e = pop();
+					e.first = -1;
+					stack.push_back(e);
+					stack.push_back(e);
+					break;
+				}
+
+				case MULT:
+				case DIV: {
+					pair<int, bool> b = pop();
+					pair<int, bool> a = pop();
+					// Константа - правый операнд или (для умножения) левый; PUSH левого
+					// операнда можно удалить: код правого операнда работает выше него
+					int constant = b.first >= 0 ? b.first : instruction == MULT ? a.first : -1;
+					bool nonNegative = instruction == DIV && a.second && b.second;
+					if(constant >= 0) {
+						int c = code_[constant].arg();
+						int k = powerOfTwo(c);
+						int m = 0;
+						int shift = 0;
+						bool reduced = true;
+						if(c == 1) {
+							command = Command(NOP);
+						}
+						else if(c == -1) {
+							command = Command(INVERT);
+						}
+						else if(instruction == MULT && k > 0) {
+							command = Command(SHL, k);
+						}
+						else if(k > 0 && k < 31 && a.second) {
+							command = Command(SHR, k);
+						}
+						else if(instruction == DIV && c > 0 && a.second && divisionMagic(c, m, shift)) {
+							// PUSH d; DIV -> MULHI m; SHR shift
+							code_[constant] = Command(MULHI, m);
+							command = shift > 0 ? Command(SHR, shift) : Command(NOP);
+							reduced = false;
+							changed = true;
+						}
+						else {
+							reduced = false;
+						}
+						if(reduced) {
+							code_[constant] = Command(NOP);
+							changed = true;
+						}
+					}
+					stack.push_back(make_pair(-1, nonNegative));
+					break;
+				}
+
+				case ADD:
+				case SUB:
+				case BITAND:
+				case BITOR:
+				case COMPARE: {
+					pair<int, bool> b = pop();
+					pair<int, bool> a = pop();
+					bool nonNegative = instruction == COMPARE || (instruction == BITAND && (a.second || b.second)) ||
+						(instruction == BITOR && a.second && b.second);
+					stack.push_back(make_pair(-1, nonNegative));
+					break;
+				}
+
+				case NOT:
+					pop();
+					stack.push_back(make_pair(-1, true));
+					break;
+
+				case SHR:
+				case INVERT:
+				case SHL:
+				case MULHI: {
+					pair<int, bool> a = pop();
+					stack.push_back(make_pair(-1, instruction == SHR && a.second));
+					break;
+				}
+
+				case LOAD:
+				case INPUT:
+					stack.push_back(unknown);
+					break;
+
+				case BLOAD:
+					pop();
+					stack.push_back(unknown);
+					break;
+
+				case BSTORE:
+					pop();
+					pop();
+					break;
+
+				case STORE:
+				case POP:
+				case PRINT:
+				case JUMP_YES:
+				case JUMP_NO:
+				case TABLESWITCH:
+					pop();
+					break;
+
+				default:
+					break;
+			}
+		}
+	}
+	return changed;
+}
+
+bool Optimizer::numberValues()
+{
+	for(const Command& command : code_) {
+		if(command.instruction() == BLOAD || command.instruction() == BSTORE) {
+			return false;
+		}
+	}
+
+	int scratchVariable = countSlots(code_);
+	operands_.assign(code_.size(), make_pair(-1, -1));
+	bool changed = false;
+	for(const Block& block : blocks_) {
+		unordered_map<ValueKey, int, ValueKeyHash> numbers; // Операция над номерами операндов - номер значения
+		unordered_map<int, int> variables; // Переменная - номер ее текущего значения
+		vector<int> holders;          // Номер значения - переменная, в которой оно записано (-1 - нет)
+		vector<int> firstAt;          // Номер значения - адрес инструкции, впервые его вычислившей
+		vector<int> scratch;          // Номер значения - временная переменная для него
+		vector<Numbered> stack;
+		Numbered fresh = { 0, -1, 0 };
+		numbers.reserve(block.end - block.first);
+
+		auto newNumber = [&]() {
+			holders.push_back(-1);
+			firstAt.push_back(-1);
+			scratch.push_back(-1);
+			return static_cast<int>(holders.size()) - 1;
+		};
+		// Значения, лежавшие на стеке до начала блока, неизвестны
+		auto pop = [&]() {
+			if(stack.empty()) {
+				Numbered e = fresh;
+				e.number = newNumber();
+				return e;
+			}
+			Numbered e = stack.back();
+			stack.pop_back();
+			return e;
+		};
+		auto lookup = [&](Instruction instruction, int arg, int left, int right) {
+			ValueKey key = { instruction, arg, left, right };
+			unordered_map<ValueKey, int, ValueKeyHash>::iterator it = numbers.find(key);
+			if(it == numbers.end()) {
+				it = numbers.insert(make_pair(key, newNumber())).first;
+			}
+			return it->second;
+		};
+
+		for(int address = block.first; address < block.end; ++address) {
+			Command& command = code_[address];
+			Instruction instruction = command.instruction();
+			switch(instruction) {
+				case PUSH:
+				case PUSH_TRUE:
+				case PUSH_FALSE: {
+					int value = instruction == PUSH ? command.arg() : instruction == PUSH_TRUE;
+					Numbered e = { lookup(PUSH, value, 0, 0), address, 1 };
+					stack.push_back(e);
+					break;
+				}
+
+				case LOAD: {
+					unordered_map<int, int>::iterator it = variables.find(command.arg());
+					if(it == variables.end()) {
+						it = variables.insert(make_pair(command.arg(), newNumber())).first;
+					}
+					Numbered e = { it->second, address, 1 };
+					stack.push_back(e);
+					break;
+				}
+
+				case DUP: {
+					Numbered e = pop();
+					e.producer = -1;
+					stack.push_back(e);
+					e.producer = address;
+					e.cost = 1;
+					stack.push_back(e);
+					break;
+				}
+
+				case STORE: {
+					Numbered e = pop();
+					variables[command.arg()] = e.number;
+					holders[e.number] = command.arg();
+					break;
+				}
+
+				case FOR_LOOP:
+					variables[command.arg2()] = newNumber();
+					break;
+
+				case POP:
+				case PRINT:
+				case JUMP_YES:
+				case JUMP_NO:
+				case TABLESWITCH:
+					pop();
+					break;
+
+				case INPUT: {
+					Numbered e = fresh;
+					e.number = newNumber();
+					stack.push_back(e);
+					break;
+				}
+
+				case ADD:
+				case SUB:
+				case MULT:
+				case DIV:
+				case BITAND:
+				case BITOR:
+				case COMPARE:
+				case INVERT:
+				case NOT:
+				case SHL:
+				case SHR:
+				case MULHI: {
+					bool unary = isUnary(instruction);
+					Numbered b = unary ? fresh : pop();
+					Numbered a = pop();
+					int left = a.number;
+					int right = unary ? -1 : b.number;
+					int arg = command.arg();
+					// Перестановочные операции: номера операндов по возрастанию,
+					// у сравнения "<" и ">" (и "<=", ">=") меняются местами
+					bool commutative = instruction == ADD || instruction == MULT || instruction == BITAND ||
+						instruction == BITOR || instruction == COMPARE;
+					if(commutative && left > right) {
+						swap(left, right);
+						if(instruction == COMPARE && arg >= 2) {
+							arg ^= 1;
+						}
+					}
+
+					Numbered e = { lookup(instruction, arg, left, right), -1, 0 };
+					if(a.producer >= 0 && (unary || b.producer >= 0)) {
+						e.producer = address;
+						e.cost = 1 + a.cost + b.cost;
+						operands_[address] = make_pair(a.producer, unary ? -1 : b.producer);
+					}
+
+					int first = firstAt[e.number];
+					if(first < 0) {
+						firstAt[e.number] = address;
+					}
+					else if(e.producer >= 0 && e.cost >= 2) {
+						// Значение уже вычислено: берется из переменной, копируется с
+						// вершины стека или сохраняется во временную переменную
+						int holder = holders[e.number];
+						bool held = holder >= 0 && variables[holder] == e.number;
+						bool below = !stack.empty() && stack.back().number == e.number;
+						if(held || below || e.cost >= MIN_SCRATCH_COST) {
+							remove(address);
+							if(held) {
+								command = Command(LOAD, holder);
+							}
+							else if(below) {
+								command = Command(DUP);
+								stack.back().producer = -1;
+							}
+							else {
+								if(scratch[e.number] < 0) {
+									scratch[e.number] = scratchVariable++;
+									inserted_.push_back(make_pair(first, Command(DUP)));
+									inserted_.push_back(make_pair(first, Command(STORE, scratch[e.number])));
+								}
+								command = Command(LOAD, scratch[e.number]);
+							}
+							operands_[address] = make_pair(-1, -1);
+							e.producer = address;
+							e.cost = 1;
+							changed = true;
+						}
+					}
+					stack.push_back(e);
+					break;
+				}
+
+				default:
+					break;
+			}
+		}
+	}
+	return changed;
+}
+
+bool Optimizer::hoistInvariants()
+{
+	for(const Command& command : code_) {
+		if(command.instruction() == BLOAD || command.instruction() == BSTORE) {
+			return false;
+		}
+	}
+
+	int blockCount = blocks_.size();
+	vector<vector<int> > predecessors(blockCount);
+	for(int b = 0; b < blockCount; ++b) {
+		for(int s : blocks_[b].successors) {
+			if(s >= 0) {
+				predecessors[s].push_back(b);
+			}
+		}
+	}
+
+	// Обратный порядок обхода в глубину от начала программы
+	vector<int> order;
+	vector<int> position(blockCount, -1);
+	{
+		vector<char> visited(blockCount, false);
+		vector<pair<int, int> > work(1, make_pair(0, 0));
+		visited[0] = true;
+		while(!work.empty()) {
+			pair<int, int>& top = work.back();
+			if(top.second < 2) {
+				int s = blocks_[top.first].successors[top.second++];
+				if(s >= 0 && !visited[s]) {
+					visited[s] = true;
+					work.push_back(make_pair(s, 0));
+				}
+				continue;
+			}
+			order.push_back(top.first);
+			work.pop_back();
+		}
+		reverse(order.begin(), order.end());
+		for(size_t i = 0; i < order.size(); ++i) {
+			position[order[i]] = i;
+		}
+	}
+
+	// Непосредственные доминаторы (Cooper, Harvey, Kennedy)
+	vector<int> idom(blockCount, -1);
+	idom[0] = 0;
+	for(bool changed = true; changed; ) {
+		changed = false;
+		for(size_t i = 1; i < order.size(); ++i) {
+			int b = order[i];
+			int dominator = -1;
+			for(int p : predecessors[b]) {
+				if(idom[p] < 0) {
+					continue;
+				}
+				if(dominator < 0) {
+					dominator = p;
+					continue;
+				}
+				int other = p;
+				while(dominator != other) {
+					while(position[dominator] > position[other]) {
+						dominator = idom[dominator];
+					}
+					while(position[other] > position[dominator]) {
+						other = idom[other];
+					}
+				}
+			}
+			if(dominator != idom[b]) {
+				idom[b] = dominator;
+				changed = true;
+			}
+		}
+	}
+
+	// Номера входа и выхода в дереве доминаторов: a доминирует над b,
+	// если интервал b вложен в интервал a
+	vector<int> enter(blockCount, -1);
+	vector<int> leave(blockCount, -1);
+	{
+		vector<vector<int> > children(blockCount);
+		for(size_t i = 1; i < order.size(); ++i) {
+			children[idom[order[i]]].push_back(order[i]);
+		}
+		int counter = 0;
+		vector<pair<int, size_t> > work(1, make_pair(0, 0));
+		enter[0] = counter++;
+		while(!work.empty()) {
+			pair<int, size_t>& top = work.back();
+			if(top.second < children[top.first].size()) {
+				int child = children[top.first][top.second++];
+				enter[child] = counter++;
+				work.push_back(make_pair(child, 0));
+				continue;
+			}
+			leave[top.first] = counter++;
+			work.pop_back();
+		}
+	}
+
+	// Естественные циклы: обратная дуга u -> h, где h доминирует над u. Тело -
+	// блоки, из которых u достижим без прохода через h; дуги continue дают
+	// еще одну обратную дугу в тот же заголовок, дуги break ведут из тела наружу
+	vector<vector<int> > sources(blockCount);
+	for(int u : order) {
+		for(int h : blocks_[u].successors) {
+			if(h >= 0 && enter[h] <= enter[u] && leave[u] <= leave[h]) {
+				sources[h].push_back(u);
+			}
+		}
+	}
+
+	vector<pair<int, vector<int> > > loops;   // Заголовок и тело цикла
+	vector<int> mark(blockCount, -1);
+	size_t work = 0;
+	for(int h : order) {
+		if(sources[h].empty() || work > MAX_LOOP_WORK) {
+			continue;
+		}
+		vector<int> body(1, h);
+		mark[h] = h;
+		for(int u : sources[h]) {
+			if(mark[u] != h) {
+				mark[u] = h;
+				body.push_back(u);
+			}
+		}
+		for(size_t i = 1; i < body.size(); ++i) {
+			for(int p : predecessors[body[i]]) {
+				if(mark[p] != h && position[p] >= 0) {
+					mark[p] = h;
+					body.push_back(p);
+				}
+			}
+		}
+		work += body.size();
+		loops.push_back(make_pair(h, body));
+	}
+
+	// Внешние циклы раньше вложенных: выражение, не меняющееся во внешнем
+	// цикле, выносится сразу из него
+	stable_sort(loops.begin(), loops.end(),
+		[](const pair<int, vector<int> >& a, const pair<int, vector<int> >& b) {
+			return a.second.size() > b.second.size();
+		});
+
+	int scratchVariable = countSlots(code_);
+	vector<int> storedIn;     // Номер цикла, в котором последний раз найдена запись в переменную
+	vector<char> inLoop(blockCount, false);
+	bool changed = false;
+	for(size_t loop = 0; loop < loops.size(); ++loop) {
+		int header = loops[loop].first;
+		const vector<int>& body = loops[loop].second;
+		for(int b : body) {
+			inLoop[b] = true;
+		}
+
+		// Предзаголовок: единственный вход в цикл снаружи - из предыдущего
+		// блока (в цикле for - после FOR_ENTRY) или из блока, который кончается
+		// JUMP на заголовок; код вставляется в конец этого блока (перед JUMP),
+		// и обратные дуги его не задевают
+		int entries = 0;
+		int outside = -1;
+		for(int p : predecessors[header]) {
+			if(!inLoop[p] && position[p] >= 0) {
+				++entries;
+				outside = p;
+			}
+		}
+		int insertAt = -1;
+		if(header > 0 && entries == 1) {
+			const Block& from = blocks_[outside];
+			const Command& last = code_[from.end - 1];
+			if(last.instruction() == JUMP) {
+				if(from.end - from.first >= 2) {
+					insertAt = from.end - 2;
+				}
+			}
+			else if(outside == header - 1 && last.instruction() != TABLESWITCH &&
+				!(hasCodeAddress(last.instruction()) && last.arg() == blocks_[header].first)) {
+				insertAt = from.end - 1;
+			}
+		}
+
+		storedIn.resize(scratchVariable, -1);
+		for(int b : body) {
+			for(int address = blocks_[b].first; address < blocks_[b].end; ++address) {
+				if(code_[address].instruction() == STORE) {
+					storedIn[code_[address].arg()] = loop;
+				}
+				else if(code_[address].instruction() == FOR_LOOP) {
+					storedIn[code_[address].arg2()] = loop;
+				}
+			}
+		}
+
+		if(insertAt >= 0) {
+			vector<pair<vector<Command>, int> > hoisted;   // Вынесенные выражения и их переменные
+
+			// Вынос выражения [first, last]: вычисление и запись в новую
+			// переменную перед заголовком, в цикле - чтение этой переменной
+			auto hoist = [&](const Operand& e) {
+				if(!e.invariant || e.cost < 2) {
+					return;
+				}
+				vector<Command> expression;
+				for(int address = e.first; address <= e.last; ++address) {
+					if(code_[address].instruction() != NOP) {
+						expression.push_back(code_[address]);
+					}
+				}
+				int variable = -1;
+				for(const pair<vector<Command>, int>& h : hoisted) {
+					if(h.first.size() == expression.size() &&
+						equal(h.first.begin(), h.first.end(), expression.begin(),
+							[](const Command& a, const Command& b) {
+								return a.instruction() == b.instruction() && a.arg() == b.arg();
+							})) {
+						variable = h.second;
+						break;
+					}
+				}
+				if(variable < 0) {
+					variable = scratchVariable++;
+					for(const Command& command : expression) {
+						inserted_.push_back(make_pair(insertAt, command));
+					}
+					inserted_.push_back(make_pair(insertAt, Command(STORE, variable)));
+					hoisted.push_back(make_pair(expression, variable));
+				}
+				for(int address = e.first; address < e.last; ++address) {
+					code_[address] = Command(NOP);
+				}
+				code_[e.last] = Command(LOAD, variable);
+				changed = true;
+			};
+
+			for(int b : body) {
+				vector<Operand> stack;
+				int impure = blocks_[b].first - 1;   // Адрес последней инструкции с побочным эффектом
+				Operand unknown = { false, 0, 0, 0 };
+				auto pop = [&]() {
+					if(stack.empty()) {
+						return unknown;
+					}
+					Operand e = stack.back();
+					stack.pop_back();
+					return e;
+				};
+
+				for(int address = blocks_[b].first; address < blocks_[b].end; ++address) {
+					Instruction instruction = code_[address].instruction();
+					switch(instruction) {
+						case NOP:
+							break;
+
+						case PUSH:
+						case PUSH_TRUE:
+						case PUSH_FALSE:
+						case LOAD: {
+							int arg = code_[address].arg();
+							bool invariant = instruction != LOAD || arg >= static_cast<int>(storedIn.size()) ||
+								storedIn[arg] != static_cast<int>(loop);
+							Operand e = { invariant, address, address, 1 };
+							stack.push_back(e);
+							break;
+						}
+
+						case ADD:
+						case SUB:
+						case MULT:
+						case DIV:
+						case BITAND:
+						case BITOR:
+						case COMPARE:
+						case INVERT:
+						case NOT:
+						case SHL:
+						case SHR:
+						case MULHI: {
+							bool unary = isUnary(instruction);
+							Operand b = { true, address, address, 0 };
+							if(!unary) {
+								b = pop();
+							}
+							Operand a = pop();
+							bool invariant = a.invariant && b.invariant && impure < a.first;
+							// Деление выносится только на ненулевую константу: иначе ошибка
+							// могла бы возникнуть, даже если цикл не выполнился ни разу
+							if(instruction == DIV && (b.cost != 1 || code_[b.last].instruction() != PUSH ||
+								code_[b.last].arg() == 0)) {
+								invariant = false;
+							}
+							if(!invariant) {
+								hoist(a);
+								if(!unary) {
+									hoist(b);
+								}
+							}
+							Operand e = { invariant, invariant ? a.first : address, address, 1 + a.cost + b.cost };
+							stack.push_back(e);
+							break;
+						}
+
+						default: {
+							// Инструкции с побочным эффектом: INPUT, PRINT, STORE, переходы...
+							impure = address;
+							int pops = instruction == STORE || instruction == POP || instruction == PRINT ||
+								instruction == DUP || instruction == JUMP_YES || instruction == JUMP_NO ||
+								instruction == TABLESWITCH;
+							for(int i = 0; i < pops; ++i) {
+								hoist(pop());
+							}
+							int pushes = instruction == DUP ? 2 : instruction == INPUT;
+							for(int i = 0; i < pushes; ++i) {
+								Operand e = { false, address, address, 1 };
+								stack.push_back(e);
+							}
+							break;
+						}
+					}
+				}
+				for(const Operand& e : stack) {
+					hoist(e);
+				}
+			}
+		}
+
+		for(int b : body) {
+			inLoop[b] = false;
+		}
+	}
+	return changed;
+}
+
+void Optimizer::compact()
+{
+	// Вставки после одного адреса сохраняют порядок добавления
+	stable_sort(inserted_.begin(), inserted_.end(),
+		[](const pair<int, Command>& a, const pair<int, Command>& b) { return a.first < b.first; });
+
+	int count = code_.size();
+	vector<int> newAddress(count + 1);
+	int next = 0;
+	size_t insert = 0;
+	for(int address = 0; address < count; ++address) {
+		newAddress[address] = next;
+		if(code_[address].instruction() != NOP) {
+			++next;
+		}
+		for(; insert < inserted_.size() && inserted_[insert].first == address; ++insert) {
+			++next;
+		}
+	}
+	newAddress[count] = next;
+
+	vector<Command> result;
+	result.reserve(next);
+	insert = 0;
+	for(int address = 0; address < count; ++address) {
+		Command command = code_[address];
+		if(hasCodeAddress(command.instruction())) {
+			command = Command(command.instruction(), newAddress[command.arg()], command.arg2());
+		}
+		if(command.instruction() != NOP) {
+			result.push_back(command);
+		}
+		for(; insert < inserted_.size() && inserted_[insert].first == address; ++insert) {
+			result.push_back(inserted_[insert].second);
+		}
+	}
+	inserted_.clear();
+	code_.swap(result);
+}
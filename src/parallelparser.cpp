@@ -0,0 +1,120 @@
+#include "../headers/parser.h"
+#include <algorithm>
+#include <thread>
+
+// Минимальное число операторов в части: меньшие программы разбираются последовательно
+static const size_t MIN_SLICE_STATEMENTS = 4096;
+
+Parser::Parser(const TokenBuffer* tokens, size_t first, size_t last)
+        : started_(chrono::steady_clock::now()), memory_(pmr::new_delete_resource()), arena_(ARENA_BLOCK, &memory_),
+          collectStats_(false), scanner_(NULL), sourceScanner_(NULL), tokens_(tokens), tokenIndex_(first),
+          tokenEnd_(last + 1), ownsTokens_(false), output_(cout), error_(false), recovered_(true),
+          reportErrors_(false), variables_(&arena_), lastVar_(0), loopStack_(&arena_), exprStack_(&arena_),
+          exprCondition_(false), ll1Parser_(false), pipeline_(false), parallelCompile_(false), threads_(1), optimize_(false),
+          llStack_(&arena_), semStack_(&arena_)
+{
+    codegen_ = create<CodeGen>(output_, false, &arena_);
+}
+
+bool Parser::parseSlice()
+{
+    size_t last = tokenEnd_ - 1;
+    for(;;) {
+        statement();
+        if(error_ || tokenIndex_ >= last) {
+            break;
+        }
+        mustBe(T_SEMICOLON);
+    }
+    return !error_ && tokenIndex_ == last;
+}
+
+//Операторы верхнего уровня разделены лексемами ';' вне конструкций if/while, поэтому
+//границы находятся одним проходом по видам лексем. Части разбираются отдельными
+//анализаторами со своими таблицами переменных и кодогенераторами; при склейке
+//номера переменных части заменяются номерами в общей таблице (в порядке первого
+//появления, как при последовательном разборе), а адреса переходов сдвигаются на
+//начало кода части. Если хотя бы в одной части есть ошибка, программа разбирается
+//последовательно, чтобы сообщения об ошибках не отличались.
+bool Parser::compileParallel()
+{
+    if(tokens_ == NULL || token() != T_BEGIN) {
+        return false;
+    }
+
+    // Номера ';' верхнего уровня и завершающей END
+    vector<size_t> separators;
+    int depth = 0;
+    for(size_t i = tokenIndex_ + 1; i < tokenEnd_; ++i) {
+        Token t = tokens_->token(i);
+        if(t == T_IF || t == T_WHILE || t == T_FOR || t == T_CASE) {
+            ++depth;
+        }
+        else if(t == T_FI || t == T_OD || t == T_ESAC) {
+            if(--depth < 0) {
+                return false;
+            }
+        }
+        else if(depth == 0 && t == T_SEMICOLON) {
+            separators.push_back(i);
+        }
+        else if(depth == 0 && t == T_END) {
+            separators.push_back(i);
+            break;
+        }
+    }
+    if(separators.empty() || tokens_->token(separators.back()) != T_END) {
+        return false;
+    }
+
+    unsigned threads = threads_ ? threads_ : max(thread::hardware_concurrency(), 1u);
+    size_t statements = separators.size();
+    size_t sliceCount = min<size_t>(threads, statements / MIN_SLICE_STATEMENTS);
+    if(sliceCount < 2) {
+        return false;
+    }
+
+    vector<Parser*> slices;
+    for(size_t k = 0; k < sliceCount; ++k) {
+        size_t firstStatement = statements * k / sliceCount;
+        size_t lastStatement = statements * (k + 1) / sliceCount - 1;
+        size_t first = firstStatement == 0 ? tokenIndex_ + 1 : separators[firstStatement - 1] + 1;
+        slices.push_back(new Parser(tokens_, first, separators[lastStatement]));
+    }
+
+    vector<char> parsed(sliceCount, false);
+    vector<thread> workers;
+    for(size_t k = 0; k + 1 < sliceCount; ++k) {
+        workers.push_back(thread([&slices, &parsed, k] {
+            parsed[k] = slices[k]->parseSlice();
+        }));
+    }
+    parsed[sliceCount - 1] = slices[sliceCount - 1]->parseSlice();
+    for(thread& worker : workers) {
+        worker.join();
+    }
+
+    bool ok = find(parsed.begin(), parsed.end(), false) == parsed.end();
+    if(ok) {
+        for(Parser* slice : slices) {
+            vector<string_view> names(slice->lastVar_);
+            for(VarTable::const_iterator it = slice->variables_.begin(); it != slice->variables_.end(); ++it) {
+                names[it->second] = it->first;
+            }
+            vector<int> addresses;
+            for(string_view name : names) {
+                addresses.push_back(findOrAddVariable(name));
+            }
+            codegen_->append(*slice->codegen_, addresses);
+        }
+
+        tokenIndex_ = separators.back();
+        next();
+        codegen_->emit(STOP);
+    }
+
+    for(Parser* slice : slices) {
+        delete slice;
+    }
+    return ok;
+}
@@ -5,10 +5,71 @@
 //никаких ошибок, то выводим последовательность команд стек-машины
 void Parser::parse()
 {
-    program();
+    compile();
     if(!error_) {
+        writeProgram();
+    }
+}
+
+void Parser::compile()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double lexBefore = stats_.lexSeconds;
+    if(ll1Parser_) {
+        parseLL1();
+    }
+    else if(!parallelCompile_ || !compileParallel()) {
+        program();
+    }
+    stats_.parseSeconds = secondsSince(start) - (stats_.lexSeconds - lexBefore);
+    if(optimize_ && !error_) {
+        optimize();
+    }
+    updateStats();
+}
+
+void Parser::optimize()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<Command> program = codegen_->program();
+    size_t before = program.size();
+    Optimizer optimizer(program);
+    if(optimizer.run()) {
+        codegen_->setProgram(program);
+        stats_.removedInstructions = before - program.size();
+    }
+    stats_.slotsBefore = optimizer.slotsBefore();
+    stats_.slotsAfter = optimizer.slotsAfter();
+    stats_.optimizeSeconds = secondsSince(start);
+}
+
+void Parser::writeProgram()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if(pipeline_) {
+        codegen_->flushPipelined();
+    }
+    else {
         codegen_->flush();
     }
+    stats_.flushSeconds = secondsSince(start);
+    updateStats();
+}
+
+void Parser::updateStats()
+{
+    if(collectStats_) {
+        stats_.totalSeconds = secondsSince(started_);
+        if(tokens_) {
+            stats_.tokens = tokens_->size();
+        }
+        stats_.identifiers = variables_.size();
+        stats_.instructions = codegen_->getCurrentAddress();
+        stats_.backpatches = codegen_->patchCount();
+        stats_.peakInstructions = codegen_->peakSize();
+        stats_.arenaBlocks = memory_.blocks();
+        stats_.arenaBytes = memory_.bytes();
+    }
 }
 
 void Parser::program()
@@ -22,7 +83,7 @@ void Parser::program()
 void Parser::statementList()
 {
 
-    if(see(T_END) || see(T_OD) || see(T_ELSE) || see(T_FI)) {
+    if(see(T_END) || see(T_OD) || see(T_ELSE) || see(T_FI) || see(T_ESAC)) {
         return;
     }
     else {
@@ -37,40 +98,34 @@ void Parser::statementList()
 void Parser::statement()
 {
     if(see(T_IDENTIFIER)) {
-        int varAddress = findOrAddVariable(scanner_->getStringValue());
+        int varAddress = findOrAddVariable(stringValue());
         next();
         mustBe(T_ASSIGN);
-
-
-        if(see(T_TRUE) || see(T_FALSE) || see(T_NOT) ||
-           see(T_LPAREN) || see(T_IDENTIFIER)) {
-
-            booleanExpression();
-        } else {
-
-            expression();
-        }
-
+        expression();
         codegen_->emit(STORE, varAddress);
     }
 
     else if(match(T_IF)) {
-        booleanExpression();
+        expression();
 
-        int jumpNoAddress = codegen_->reserve();
+        int elseLabel = codegen_->newLabel();
+        codegen_->emitJump(JUMP_NO, elseLabel);
 
         mustBe(T_THEN);
         statementList();
         if(match(T_ELSE)) {
 
-            int jumpAddress = codegen_->reserve();
-            codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+            int endLabel = codegen_->newLabel();
+            codegen_->emitJump(JUMP, endLabel);
+            codegen_->bindLabel(elseLabel);
             statementList();
-            codegen_->emitAt(jumpAddress, JUMP, codegen_->getCurrentAddress());
+            codegen_->bindLabel(endLabel);
+            codegen_->freeLabel(endLabel);
         }
         else {
-            codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+            codegen_->bindLabel(elseLabel);
         }
+        codegen_->freeLabel(elseLabel);
 
         mustBe(T_FI);
     }
@@ -79,48 +134,89 @@ void Parser::statement()
 
 
 
-        int conditionAddress = codegen_->getCurrentAddress();
+        int conditionLabel = codegen_->newLabel();
+        codegen_->bindLabel(conditionLabel);
         relation();
 
-        int jumpNoAddress = codegen_->reserve();
+        int exitLabel = codegen_->newLabel();
+        codegen_->emitJump(JUMP_NO, exitLabel);
 
         LoopContext context;
-        context.conditionAddress = conditionAddress;
-        context.exitAddress = jumpNoAddress;
+        context.conditionLabel = conditionLabel;
+        context.exitLabel = exitLabel;
         loopStack_.push(context);
 
         mustBe(T_DO);
         statementList();
         mustBe(T_OD);
 
-        codegen_->emit(JUMP, conditionAddress);
-
+        codegen_->emitJump(JUMP, conditionLabel);
 
-        int exitAddress = codegen_->getCurrentAddress();
 
-
-        codegen_->emitAt(jumpNoAddress, JUMP_NO, exitAddress);
-
-
-        for(int breakAddr : loopStack_.top().breakAddresses) {
-            codegen_->emitAt(breakAddr, JUMP, exitAddress);
-        }
+        // Переходы по break уже стоят в цепочке метки выхода
+        codegen_->bindLabel(exitLabel);
+        codegen_->freeLabel(conditionLabel);
+        codegen_->freeLabel(exitLabel);
 
 
         loopStack_.pop();
     }
-    else if(match(T_WRITE)) {
-        mustBe(T_LPAREN);
-
-
-        if(see(T_TRUE) || see(T_FALSE) || see(T_NOT) || see(T_LPAREN)) {
-
-            booleanExpression();
-        } else {
+    else if(match(T_FOR)) {
+        int varAddress = 0;
+        if(see(T_IDENTIFIER)) {
+            varAddress = findOrAddVariable(stringValue());
+        }
+        mustBe(T_IDENTIFIER);
+        mustBe(T_ASSIGN);
+        expression();
+        codegen_->emit(STORE, varAddress);
 
+        mustBeWord("to");
+        expression();
+        if(see(T_DO)) {
+            codegen_->emit(PUSH, 1);
+        }
+        else {
+            mustBeWord("step");
             expression();
+            forStep();
         }
 
+        mustBe(T_DO);
+        int bodyLabel = forBegin(varAddress);
+        statementList();
+        mustBe(T_OD);
+        forEnd(varAddress, bodyLabel);
+    }
+    else if(match(T_CASE)) {
+        expression();
+        mustBeWord("of");
+        caseBegin();
+        while(see(T_NUMBER) || see(T_ADDOP)) {
+            bool negative = false;
+            if(see(T_ADDOP)) {
+                if(arithmeticValue() != A_MINUS) {
+                    reportError("case label expected.");
+                }
+                negative = arithmeticValue() == A_MINUS;
+                next();
+            }
+            caseLabel(negative ? -intValue() : intValue());
+            mustBe(T_NUMBER);
+            mustBe(T_COLON);
+            caseStatements();
+            caseArmEnd();
+        }
+        if(match(T_ELSE)) {
+            caseElse();
+            statementList();
+        }
+        mustBe(T_ESAC);
+        caseEnd();
+    }
+    else if(match(T_WRITE)) {
+        mustBe(T_LPAREN);
+        expression();
         mustBe(T_RPAREN);
         codegen_->emit(PRINT);
     }
@@ -132,8 +228,7 @@ void Parser::statement()
         if(loopStack_.empty()) {
             reportError("'break' statement outside of loop");
         } else {
-            int breakJumpAddress = codegen_->reserve();
-            loopStack_.top().breakAddresses.push_back(breakJumpAddress);
+            codegen_->emitJump(JUMP, loopStack_.top().exitLabel);
         }
     }
     else if(match(T_CONTINUE)) {
@@ -142,10 +237,7 @@ void Parser::statement()
             reportError("'continue' statement outside of loop");
         } else {
 
-            int conditionAddress = loopStack_.top().conditionAddress;
-
-
-            codegen_->emit(JUMP, conditionAddress);
+            codegen_->emitJump(JUMP, loopStack_.top().conditionLabel);
         }
     }
     else {
@@ -154,189 +246,202 @@ void Parser::statement()
 }
 
 
-void Parser::booleanExpression() {
-    booleanTerm();
-
-    while(see(T_OR) || see(T_BITOR)) {
-        bool isShortCircuit = (scanner_->token() == T_OR);
-        next();
+// Приоритеты бинарных операций. Чем больше число, тем сильнее связывает операция.
+// Префиксный "!" имеет приоритет PREC_NOT, поэтому "!a < b" означает "!(a < b)",
+// унарный минус связывает сильнее всех бинарных операций.
+enum {
+    PREC_NONE = 0,
+    PREC_OR,        // "||", "|"
+    PREC_AND,       // "&&", "&"
+    PREC_NOT,       // префиксный "!"
+    PREC_CMP,       // операции сравнения
+    PREC_ADD,       // "+", "-"
+    PREC_MUL,       // "*", "/"
+    PREC_UNARY      // префиксный "-"
+};
+
+static int binaryPrecedence(Token t)
+{
+    switch(t) {
+        case T_OR:
+        case T_BITOR:
+            return PREC_OR;
+        case T_AND:
+        case T_BITAND:
+            return PREC_AND;
+        case T_CMP:
+            return PREC_CMP;
+        case T_ADDOP:
+            return PREC_ADD;
+        case T_MULOP:
+            return PREC_MUL;
+        default:
+            return PREC_NONE;
+    }
+}
 
-        if(isShortCircuit) {
-            int checkNonZeroAddr = codegen_->reserve();
-            int shortCircuitAddr = codegen_->reserve();
+// Коды операций сравнения в инструкции COMPARE виртуальной машины
+static int compareCode(Cmp cmp)
+{
+    switch(cmp) {
+        case C_EQ: return 0;
+        case C_NE: return 1;
+        case C_LT: return 2;
+        case C_GT: return 3;
+        case C_LE: return 4;
+        case C_GE: return 5;
+    }
+    return 0;
+}
 
-            codegen_->emitAt(checkNonZeroAddr, DUP);
-            codegen_->emitAt(shortCircuitAddr, JUMP_YES, shortCircuitAddr + 3);
+bool Parser::expression()
+{
+    /*
+        Выражение любого вида (арифметическое, сравнение, логическое) разбирается методом
+        предшествования операций. Операции и открывающие скобки хранятся в явном стеке exprStack_,
+        код операндов генерируется сразу, код операции - при ее свертке. Рекурсии нет, поэтому
+        глубина вложенности скобок ограничена только памятью.
 
-            codegen_->emit(POP);
-            booleanTerm();
+        Возвращает true, если на верхнем уровне выражения стоит сравнение или логическая операция.
+    */
+    size_t base = exprStack_.size();
+    int openParens = 0;
+    bool expectOperand = true;
+
+    for(;;) {
+        if(expectOperand) {
+            ExprOperator op = { T_EOF, 0, PREC_NONE, -1, true };
+            if(see(T_LPAREN)) {
+                op.token = T_LPAREN;
+                ++openParens;
+            }
+            else if(see(T_ADDOP) && arithmeticValue() == A_MINUS) {
+                op.token = T_ADDOP;
+                op.value = A_MINUS;
+                op.precedence = PREC_UNARY;
+            }
+            else if(see(T_NOT)) {
+                op.token = T_NOT;
+                op.precedence = PREC_NOT;
+            }
+            else {
+                factor();
+                expectOperand = false;
+                continue;
+            }
+            next();
+            exprStack_.push_back(op);
         }
-        else {
-
-            booleanTerm();
-
+        else if(int precedence = binaryPrecedence(token())) {
+            ExprOperator op = { token(), 0, precedence, -1, false };
+            if(see(T_CMP)) {
+                op.value = cmpValue();
+            }
+            else if(see(T_ADDOP) || see(T_MULOP)) {
+                op.value = arithmeticValue();
+            }
+            next();
 
-            codegen_->emit(ADD);
+            // Левый операнд завершен, когда свернуты все операции с тем же или большим приоритетом
+            reduceExpression(base, precedence);
 
+            if(op.token == T_OR || op.token == T_AND) {
+                op.label = codegen_->newLabel();
+                codegen_->emit(DUP);
+                codegen_->emitJump(op.token == T_OR ? JUMP_YES : JUMP_NO, op.label);
+                codegen_->emit(POP);
+            }
 
-            codegen_->emit(PUSH, 0);
-            codegen_->emit(COMPARE, 3);
+            exprStack_.push_back(op);
+            expectOperand = true;
         }
-    }
-}
-/*
-void Parser::booleanTerm() {
-    booleanFactor();
-
-    while(see(T_AND) || see(T_BITAND)) {
-        bool isShortCircuit = (scanner_->token() == T_AND);
-        next();
-
-        if(isShortCircuit) {
-
-            int shortCircuitAddr = codegen_->reserve();
-            codegen_->emitAt(shortCircuitAddr, JUMP_NO, shortCircuitAddr + 3);
-
-            booleanFactor();
-            codegen_->emit(MULT);
+        else if(openParens > 0 && match(T_RPAREN)) {
+            reduceExpression(base, PREC_NONE);
+            exprStack_.pop_back();
+            --openParens;
         }
         else {
-
-            booleanFactor();
-
-            codegen_->emit(MULT);
+            break;
         }
     }
-}*/
-
-void Parser::booleanTerm() {
-    booleanFactor();
-
-    while(see(T_AND) || see(T_BITAND)) {
-        bool isShortCircuit = (scanner_->token() == T_AND);
-        next();
-
-        if(isShortCircuit) {
-            codegen_->emit(DUP);
 
-            int jumpEndAddr = codegen_->reserve();
-
-
-            codegen_->emit(POP);
-
-            booleanFactor();
-
-            codegen_->emit(MULT);
-
-            int endAddr = codegen_->getCurrentAddress();
+    reduceExpression(base, PREC_NONE);
+    while(openParens > 0) {
+        exprStack_.pop_back();
+        --openParens;
+        mustBe(T_RPAREN);
+        reduceExpression(base, PREC_NONE);
+    }
 
-            codegen_->emitAt(jumpEndAddr, JUMP_NO, endAddr);
-        }
-        else {
-            booleanFactor();
+    return exprCondition_;
+}
 
-            codegen_->emit(MULT);
+void Parser::reduceExpression(size_t base, int precedence)
+{
+    // Свертка операций до открывающей скобки или до операции с меньшим приоритетом
+    while(exprStack_.size() > base) {
+        const ExprOperator& op = exprStack_.back();
+        if(op.token == T_LPAREN || op.precedence < precedence) {
+            break;
         }
+        applyOperator(op);
+        exprStack_.pop_back();
     }
 }
-void Parser::booleanFactor() {
-    if(match(T_NOT)) {
-        /*booleanFactor();
-
-
-        int notTrueAddr = codegen_->reserve();
-        int jumpAddr = codegen_->reserve();
 
-        codegen_->emitAt(notTrueAddr, JUMP_NO, notTrueAddr + 2);
-        codegen_->emitAt(notTrueAddr + 1, PUSH, 0);
-        codegen_->emitAt(jumpAddr, JUMP, jumpAddr + 2);
-        codegen_->emit(PUSH, 1);*/
-        booleanFactor();
-        // Implement NOT using equality comparison: NOT x = (x == 0)
-        codegen_->emit(PUSH, 0);
-        codegen_->emit(COMPARE, C_EQ);
-    }
-    else if(match(T_TRUE)) {
-        codegen_->emit(PUSH, 1);
-    }
-    else if(match(T_FALSE)) {
-        codegen_->emit(PUSH, 0);
-    }
-    else if(match(T_LPAREN)) {
-        booleanExpression();
-        mustBe(T_RPAREN);
-    }
-    else {
-        if(see(T_IDENTIFIER)) {
-            int varAddress = findOrAddVariable(scanner_->getStringValue());
-            next();
-            codegen_->emit(LOAD, varAddress);
-        }
-        else if(see(T_NUMBER)) {
-            int value = scanner_->getIntValue();
-            next();
-            codegen_->emit(PUSH, value);
-        }
-        else {
-            expression();
-            if(see(T_CMP)) {
-                Cmp cmp = scanner_->getCmpValue();
-                next();
-                expression();
-                codegen_->emit(COMPARE, cmp);
+void Parser::applyOperator(const ExprOperator& op)
+{
+    switch(op.token) {
+        case T_ADDOP:
+            if(op.prefix) {
+                codegen_->emit(INVERT);
             }
             else {
-                reportError("boolean expression expected");
+                codegen_->emit(op.value == A_PLUS ? ADD : SUB);
             }
-        }
-    }
-}
+            exprCondition_ = false;
+            break;
 
-void Parser::expression()
-{
+        case T_MULOP:
+            codegen_->emit(op.value == A_MULTIPLY ? MULT : DIV);
+            exprCondition_ = false;
+            break;
 
-    /*
-        Арифметическое выражение описывается следующими правилами: <expression> -> <term> | <term> + <term> | <term> - <term>
-        При разборе сначала смотрим первый терм, затем анализируем очередной символ. Если это '+' или '-',
-		удаляем его из потока и разбираем очередное слагаемое (вычитаемое). Повторяем проверку и разбор очередного
-		терма, пока не встретим за термом символ, отличный от '+' и '-'
-    */
+        case T_CMP:
+            codegen_->emit(COMPARE, compareCode(static_cast<Cmp>(op.value)));
+            exprCondition_ = true;
+            break;
 
-    term();
-    while(see(T_ADDOP)) {
-        Arithmetic op = scanner_->getArithmeticValue();
-        next();
-        term();
+        case T_NOT:
+            // NOT x реализуется как сравнение x == 0
+            codegen_->emit(PUSH, 0);
+            codegen_->emit(COMPARE, compareCode(C_EQ));
+            exprCondition_ = true;
+            break;
+
+        case T_BITAND:
+            codegen_->emit(MULT);
+            exprCondition_ = true;
+            break;
 
-        if(op == A_PLUS) {
+        case T_BITOR:
+            // Сумма операндов больше нуля
             codegen_->emit(ADD);
-        }
-        else {
-            codegen_->emit(SUB);
-        }
-    }
-}
+            codegen_->emit(PUSH, 0);
+            codegen_->emit(COMPARE, compareCode(C_GT));
+            exprCondition_ = true;
+            break;
 
-void Parser::term()
-{
-    /*
-		Терм описывается следующими правилами: <expression> -> <factor> | <factor> + <factor> | <factor> - <factor>
-        При разборе сначала смотрим первый множитель, затем анализируем очередной символ. Если это '*' или '/',
-		удаляем его из потока и разбираем очередное слагаемое (вычитаемое). Повторяем проверку и разбор очередного
-		множителя, пока не встретим за ним символ, отличный от '*' и '/'
-	*/
-    factor();
-    while(see(T_MULOP)) {
-        Arithmetic op = scanner_->getArithmeticValue();
-        next();
-        factor();
+        case T_AND:
+        case T_OR:
+            // Если результат известен по левому операнду, он остается на стеке
+            codegen_->bindLabel(op.label);
+            codegen_->freeLabel(op.label);
+            exprCondition_ = true;
+            break;
 
-        if(op == A_MULTIPLY) {
-            codegen_->emit(MULT);
-        }
-        else {
-            codegen_->emit(DIV);
-        }
+        default:
+            break;
     }
 }
 
@@ -344,31 +449,31 @@ void Parser::factor()
 {
     /*
 		Множитель описывается следующими правилами:
-		<factor> -> number | identifier | -<factor> | (<expression>) | READ
+		<factor> -> number | identifier | READ | TRUE | FALSE
+		Унарные операции и скобки обрабатываются в expression()
 	*/
+    exprCondition_ = false;
     if(see(T_NUMBER)) {
-        int value = scanner_->getIntValue();
+        int value = intValue();
         next();
         codegen_->emit(PUSH, value);
     }
     else if(see(T_IDENTIFIER)) {
-        int varAddress = findOrAddVariable(scanner_->getStringValue());
+        int varAddress = findOrAddVariable(stringValue());
         next();
         codegen_->emit(LOAD, varAddress);
-
-    }
-    else if(see(T_ADDOP) && scanner_->getArithmeticValue() == A_MINUS) {
-        next();
-        factor();
-        codegen_->emit(INVERT);
-    }
-    else if(match(T_LPAREN)) {
-        expression();
-        mustBe(T_RPAREN);
     }
     else if(match(T_READ)) {
         codegen_->emit(INPUT);
     }
+    else if(match(T_TRUE)) {
+        codegen_->emit(PUSH, 1);
+        exprCondition_ = true;
+    }
+    else if(match(T_FALSE)) {
+        codegen_->emit(PUSH, 0);
+        exprCondition_ = true;
+    }
     else {
         reportError("expression expected.");
     }
@@ -385,43 +490,192 @@ void Parser::relation()
         codegen_->emit(PUSH_FALSE);
         return;
     }
-    expression();
-    if(see(T_CMP)) {
-        Cmp cmp = scanner_->getCmpValue();
-        next();
-        expression();
-        switch(cmp) {
-            case C_EQ:
-                codegen_->emit(COMPARE, 0);
-                break;
-            case C_NE:
-                codegen_->emit(COMPARE, 1);
-                break;
-            case C_LT:
-                codegen_->emit(COMPARE, 2);
-                break;
-            case C_GT:
-                codegen_->emit(COMPARE, 3);
-                break;
-            case C_LE:
-                codegen_->emit(COMPARE, 4);
-                break;
-            case C_GE:
-                codegen_->emit(COMPARE, 5);
-                break;
-        };
 
+    if(!expression()) {
+        reportError("comparison operator expected.");
+    }
+}
+
+// Предел и шаг лежат на стеке все время цикла. FOR_ENTRY обходит тело, если
+// начальное значение уже за пределом или шаг равен 0; FOR_LOOP после тела
+// прибавляет шаг и возвращается в начало тела, пока переменная не прошла предел.
+// Значение, которое вышло бы за пределы int, тоже заканчивает цикл, поэтому
+// цикл всегда конечен. continue ведет на FOR_LOOP, break - на снятие предела
+// и шага со стека.
+int Parser::forBegin(int varAddress)
+{
+    LoopContext context;
+    context.conditionLabel = codegen_->newLabel();
+    context.exitLabel = codegen_->newLabel();
+    codegen_->emitJump(FOR_ENTRY, context.exitLabel, varAddress);
+    loopStack_.push(context);
+
+    int bodyLabel = codegen_->newLabel();
+    codegen_->bindLabel(bodyLabel);
+    return bodyLabel;
+}
+
+// Шаг, записанный числом 0, - ошибка. Шаг, который равен 0 только при выполнении
+// (-0, переменная), не ошибка: тело такого цикла не выполняется ни разу
+void Parser::forStep()
+{
+    Command step = codegen_->lastCommand();
+    if(step.instruction() == PUSH && step.arg() == 0) {
+        reportError("zero step in for loop.");
+    }
+}
+
+void Parser::forEnd(int varAddress, int bodyLabel)
+{
+    codegen_->bindLabel(loopStack_.top().conditionLabel);
+    codegen_->emitJump(FOR_LOOP, bodyLabel, varAddress);
+    codegen_->bindLabel(loopStack_.top().exitLabel);
+    codegen_->emit(POP);
+    codegen_->emit(POP);
+
+    codegen_->freeLabel(bodyLabel);
+    codegen_->freeLabel(loopStack_.top().conditionLabel);
+    codegen_->freeLabel(loopStack_.top().exitLabel);
+    loopStack_.pop();
+}
+
+// Варианты отделяются друг от друга меткой: ";" после последнего оператора
+// варианта может стоять, а может и не стоять, лишние ";" пропускаются
+void Parser::caseStatements()
+{
+    while(!see(T_NUMBER) && !see(T_ADDOP) && !see(T_ELSE) && !see(T_ESAC)) {
+        if(match(T_SEMICOLON)) {
+            continue;
+        }
+        statement();
+        if(!match(T_SEMICOLON)) {
+            return;
+        }
+    }
+}
+
+// Селектор остается на стеке, пока выполняется переход через код вариантов
+// к коду выбора: метки всех вариантов известны только после esac.
+void Parser::caseBegin()
+{
+    CaseContext context;
+    context.dispatchLabel = codegen_->newLabel();
+    context.exitLabel = codegen_->newLabel();
+    context.elseLabel = -1;
+    context.firstArm = caseArms_.size();
+    codegen_->emitJump(JUMP, context.dispatchLabel);
+    caseStack_.push(context);
+}
+
+void Parser::caseLabel(int value)
+{
+    for(size_t i = caseStack_.top().firstArm; i < caseArms_.size(); ++i) {
+        if(caseArms_[i].value == value) {
+            reportError("duplicate case label.");
+            break;
+        }
+    }
+    CaseArm arm = { value, codegen_->newLabel() };
+    codegen_->bindLabel(arm.label);
+    caseArms_.push_back(arm);
+}
+
+void Parser::caseArmEnd()
+{
+    codegen_->emitJump(JUMP, caseStack_.top().exitLabel);
+}
+
+void Parser::caseElse()
+{
+    caseStack_.top().elseLabel = codegen_->newLabel();
+    codegen_->bindLabel(caseStack_.top().elseLabel);
+}
+
+// Таблица переходов занимает по слову на каждое значение из диапазона меток,
+// зато выбор стоит двух инструкций; при редких метках выбор - двоичный поиск
+// по селектору, записанному во временную переменную.
+void Parser::caseEnd()
+{
+    CaseContext context = caseStack_.top();
+    caseStack_.pop();
+    if(context.elseLabel >= 0) {
+        codegen_->emitJump(JUMP, context.exitLabel);
+    }
+    codegen_->bindLabel(context.dispatchLabel);
+
+    int defaultLabel = context.elseLabel >= 0 ? context.elseLabel : context.exitLabel;
+    size_t first = context.firstArm;
+    size_t last = caseArms_.size();
+    sort(caseArms_.begin() + first, caseArms_.end(),
+        [](const CaseArm& a, const CaseArm& b) { return a.value < b.value; });
+
+    int64_t range = last > first ? int64_t(caseArms_[last - 1].value) - caseArms_[first].value + 1 : 0;
+    if(first == last) {
+        codegen_->emit(POP);
+        codegen_->emitJump(JUMP, defaultLabel);
+    }
+    else if(range <= int64_t(CASE_TABLE_SPREAD) * int64_t(last - first) && range <= MAX_CASE_TABLE) {
+        int low = caseArms_[first].value;
+        codegen_->emit(TABLESWITCH, low, static_cast<int>(range));
+        size_t arm = first;
+        for(int64_t value = low; value < low + range; ++value) {
+            if(caseArms_[arm].value == value) {
+                codegen_->emitJump(JUMP, caseArms_[arm++].label);
+            }
+            else {
+                codegen_->emitJump(JUMP, defaultLabel);
+            }
+        }
+        codegen_->emitJump(JUMP, defaultLabel);
     }
     else {
-        reportError("comparison operator expected.");
+        int selector = findOrAddVariable("$case");
+        codegen_->emit(STORE, selector);
+        caseSearch(first, last, selector, defaultLabel);
+    }
+    codegen_->bindLabel(context.exitLabel);
+
+    for(size_t i = first; i < last; ++i) {
+        codegen_->freeLabel(caseArms_[i].label);
+    }
+    caseArms_.resize(first);
+    codegen_->freeLabel(context.dispatchLabel);
+    codegen_->freeLabel(context.exitLabel);
+    if(context.elseLabel >= 0) {
+        codegen_->freeLabel(context.elseLabel);
+    }
+}
+
+void Parser::caseSearch(size_t first, size_t last, int selector, int defaultLabel)
+{
+    if(last - first <= CASE_LINEAR_ARMS) {
+        for(size_t i = first; i < last; ++i) {
+            codegen_->emit(LOAD, selector);
+            codegen_->emit(PUSH, caseArms_[i].value);
+            codegen_->emit(COMPARE, compareCode(C_EQ));
+            codegen_->emitJump(JUMP_YES, caseArms_[i].label);
+        }
+        codegen_->emitJump(JUMP, defaultLabel);
+        return;
     }
+
+    size_t middle = first + (last - first) / 2;
+    int upperLabel = codegen_->newLabel();
+    codegen_->emit(LOAD, selector);
+    codegen_->emit(PUSH, caseArms_[middle].value);
+    codegen_->emit(COMPARE, compareCode(C_GE));
+    codegen_->emitJump(JUMP_YES, upperLabel);
+    caseSearch(first, middle, selector, defaultLabel);
+    codegen_->bindLabel(upperLabel);
+    caseSearch(middle, last, selector, defaultLabel);
+    codegen_->freeLabel(upperLabel);
 }
 
-int Parser::findOrAddVariable(const string& var)
+int Parser::findOrAddVariable(string_view var)
 {
     VarTable::iterator it = variables_.find(var);
     if(it == variables_.end()) {
-        variables_[var] = lastVar_;
+        variables_.emplace(var, lastVar_);
         return lastVar_++;
     }
     else {
@@ -436,7 +690,7 @@ void Parser::mustBe(Token t)
 
         // Подготовим сообщение об ошибке
         std::ostringstream msg;
-        msg << tokenToString(scanner_->token()) << " found while " << tokenToString(t) << " expected.";
+        msg << tokenToString(token()) << " found while " << tokenToString(t) << " expected.";
         reportError(msg.str());
 
         // Попытка восстановления после ошибки.
@@ -444,6 +698,29 @@ void Parser::mustBe(Token t)
     }
 }
 
+// Слова "to", "step" и "of" не зарезервированы: в старых программах так названы
+// переменные. В for и case они читаются как идентификаторы с этим именем.
+void Parser::mustBeWord(const char* word)
+{
+    if(see(T_IDENTIFIER) && stringValue() == word) {
+        next();
+        return;
+    }
+    error_ = true;
+
+    std::ostringstream msg;
+    msg << tokenToString(token()) << " found while '" << word << "' expected.";
+    reportError(msg.str());
+
+    // Восстановление, как в recover(): пропускаем лексемы до этого слова
+    while(!(see(T_IDENTIFIER) && stringValue() == word) && !see(T_EOF)) {
+        next();
+    }
+    if(!see(T_EOF)) {
+        next();
+    }
+}
+
 void Parser::recover(Token t)
 {
     while(!see(t) && !see(T_EOF)) {
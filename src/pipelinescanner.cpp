@@ -0,0 +1,96 @@
+#include "../headers/pipelinescanner.h"
+
+PipelineScanner::PipelineScanner(Scanner* source)
+	: Scanner(source->getFileName(), noInput(), false),
+	  source_(source), ring_(RING_SIZE), position_(0)
+{
+	token_ = T_EOF;
+	producer_ = thread(&PipelineScanner::produce, this);
+}
+
+PipelineScanner::~PipelineScanner()
+{
+	ring_.cancel();
+	producer_.join();
+}
+
+void PipelineScanner::produce()
+{
+	TokenBatch batch;
+	batch.reserve(BATCH_SIZE);
+	for(;;) {
+		source_->nextToken();
+
+		TokenRecord record;
+		record.token = source_->token();
+		record.value = 0;
+		record.line = source_->getLineNumber();
+		record.offset = source_->getTokenOffset();
+		switch(record.token) {
+			case T_NUMBER:
+				record.value = source_->getIntValue();
+				break;
+			case T_CMP:
+				record.value = source_->getCmpValue();
+				break;
+			case T_ADDOP:
+			case T_MULOP:
+				record.value = source_->getArithmeticValue();
+				break;
+			case T_IDENTIFIER:
+				record.name = source_->getStringValue();
+				break;
+			default:
+				break;
+		}
+		batch.push_back(move(record));
+
+		bool last = source_->token() == T_EOF;
+		if(last || batch.size() == BATCH_SIZE) {
+			if(!ring_.push(move(batch))) {
+				return;
+			}
+			batch = TokenBatch();
+			batch.reserve(BATCH_SIZE);
+		}
+		if(last) {
+			ring_.close();
+			return;
+		}
+	}
+}
+
+void PipelineScanner::nextToken()
+{
+	if(position_ == batch_.size()) {
+		// После T_EOF буфер пуст, и текущей остается T_EOF
+		if(!ring_.pop(batch_)) {
+			batch_.clear();
+			position_ = 0;
+			return;
+		}
+		position_ = 0;
+	}
+
+	TokenRecord& record = batch_[position_++];
+	token_ = record.token;
+	lineNumber_ = record.line;
+	tokenOffset_ = record.offset;
+	switch(token_) {
+		case T_NUMBER:
+			intValue_ = record.value;
+			break;
+		case T_CMP:
+			cmpValue_ = static_cast<Cmp>(record.value);
+			break;
+		case T_ADDOP:
+		case T_MULOP:
+			arithmeticValue_ = static_cast<Arithmetic>(record.value);
+			break;
+		case T_IDENTIFIER:
+			stringValue_.swap(record.name);
+			break;
+		default:
+			break;
+	}
+}
@@ -1,7 +1,7 @@
 #include "../headers/scanner.h"
-#include <algorithm>
+#include "../headers/textscan.h"
 #include <iostream>
-#include <cctype>
+#include <cstdio>
 
 using namespace std;
 
@@ -37,6 +37,10 @@ static const char * tokenNames_[] = {
         "'&&'",
         "'||'",
         "'!'",
+        "'FOR'",
+        "'CASE'",
+        "'ESAC'",
+        "':'",
 };
 
 void Scanner::nextToken()
@@ -45,16 +49,15 @@ void Scanner::nextToken()
 
     // Handle comments
     while(ch_ == '/') {
+        tokenOffset_ = bufferOffset_ + position_;
         nextChar();
         if(ch_ == '*') {  // Block comment
             nextChar();
             bool inside = true;
             while(inside) {
-                while(ch_ != '*' && !input_.eof()) {
-                    nextChar();
-                }
+                skipUntil('*');
 
-                if(input_.eof()) {
+                if(eof_) {
                     token_ = T_EOF;
                     return;
                 }
@@ -67,9 +70,7 @@ void Scanner::nextToken()
             }
         }
         else if(ch_ == '/') {  // Line comment
-            while(ch_ != '\n' && !input_.eof()) {
-                nextChar();
-            }
+            skipUntil('\n');
             if(ch_ == '\n') {
                 ++lineNumber_;
                 nextChar();
@@ -84,37 +85,33 @@ void Scanner::nextToken()
         skipSpace();
     }
 
-    if(input_.eof()) {
+    tokenOffset_ = bufferOffset_ + position_;
+    if(eof_) {
         token_ = T_EOF;
         return;
     }
 
-    if(isdigit(ch_)) {
+    unsigned char kind = charClass(ch_);
+    if(kind & CC_DIGIT) {
         int value = 0;
-        while(isdigit(ch_)) {
+        do {
             value = value * 10 + (ch_ - '0');
             nextChar();
-        }
+        } while(charClass(ch_) & CC_DIGIT);
         token_ = T_NUMBER;
         intValue_ = value;
     }
-    else if(isIdentifierStart(ch_)) {
-        string buffer;
-        while(isIdentifierBody(ch_)) {
-            buffer += ch_;
+    else if(kind & CC_LETTER) {
+        // Буквы переводятся в нижний регистр при копировании: у строчных букв
+        // и цифр бит 0x20 уже установлен. Имя собирается прямо в stringValue_,
+        // чтобы не выделять память под каждое имя.
+        stringValue_.clear();
+        do {
+            stringValue_ += static_cast<char>(ch_ | 0x20);
             nextChar();
-        }
-
-        transform(buffer.begin(), buffer.end(), buffer.begin(), ::tolower);
+        } while(isIdentifierBody(ch_));
 
-        map<string, Token>::iterator kwd = keywords_.find(buffer);
-        if(kwd == keywords_.end()) {
-            token_ = T_IDENTIFIER;
-            stringValue_ = buffer;
-        }
-        else {
-            token_ = kwd->second;
-        }
+        token_ = keywordOrIdentifier();
     }
     else {
         switch(ch_) {
@@ -137,7 +134,7 @@ void Scanner::nextToken()
                     nextChar();
                 }
                 else {
-                    token_ = T_ILLEGAL;
+                    token_ = T_COLON;
                 }
                 break;
             case '<':
@@ -223,17 +220,87 @@ void Scanner::nextToken()
 
 void Scanner::skipSpace()
 {
-    while(isspace(ch_)) {
-        if(ch_ == '\n') {
-            ++lineNumber_;
+    while(!eof_) {
+        position_ += scanWhitespace(&buffer_[position_], bufferSize_ - position_, lineNumber_);
+        if(position_ < bufferSize_) {
+            ch_ = buffer_[position_];
+            return;
         }
-        nextChar();
+        fillBuffer();
+    }
+}
+
+void Scanner::skipUntil(char c)
+{
+    while(!eof_) {
+        position_ += scanUntil(&buffer_[position_], bufferSize_ - position_, c, lineNumber_);
+        if(position_ < bufferSize_) {
+            ch_ = buffer_[position_];
+            return;
+        }
+        fillBuffer();
     }
 }
 
 void Scanner::nextChar()
 {
-    ch_ = input_.get();
+    if(++position_ < bufferSize_) {
+        ch_ = buffer_[position_];
+    }
+    else {
+        fillBuffer();
+    }
+}
+
+void Scanner::fillBuffer()
+{
+    if(buffer_.empty()) {
+        buffer_.resize(BUFFER_SIZE);
+    }
+
+    bufferOffset_ += bufferSize_;
+    input_.read(&buffer_[0], BUFFER_SIZE);
+    position_ = 0;
+    bufferSize_ = static_cast<size_t>(input_.gcount());
+    if(bufferSize_ == 0) {
+        // Конец потока: ch_ получает то же значение, что вернул бы input_.get()
+        eof_ = true;
+        ch_ = static_cast<char>(EOF);
+    }
+    else {
+        ch_ = buffer_[0];
+    }
+}
+
+const map<string, Token>& Scanner::keywords()
+{
+    static const map<string, Token> table = {
+        { "begin", T_BEGIN },
+        { "end", T_END },
+        { "if", T_IF },
+        { "then", T_THEN },
+        { "else", T_ELSE },
+        { "fi", T_FI },
+        { "while", T_WHILE },
+        { "do", T_DO },
+        { "od", T_OD },
+        { "write", T_WRITE },
+        { "read", T_READ },
+        { "break", T_BREAK },
+        { "continue", T_CONTINUE },
+        { "true", T_TRUE },
+        { "false", T_FALSE },
+        { "for", T_FOR },
+        { "case", T_CASE },
+        { "esac", T_ESAC }
+    };
+    return table;
+}
+
+istream& Scanner::noInput()
+{
+    static istream stream(NULL);
+    return stream;
 }
 
 const char * tokenToString(Token t)
@@ -0,0 +1,22 @@
+#include "../headers/stats.h"
+
+void CompileStats::printJson(ostream& os) const
+{
+	os << "{"
+	   << "\"lex_seconds\": " << lexSeconds << ", "
+	   << "\"parse_seconds\": " << parseSeconds << ", "
+	   << "\"flush_seconds\": " << flushSeconds << ", "
+	   << "\"optimize_seconds\": " << optimizeSeconds << ", "
+	   << "\"total_seconds\": " << totalSeconds << ", "
+	   << "\"tokens\": " << tokens << ", "
+	   << "\"identifiers\": " << identifiers << ", "
+	   << "\"instructions\": " << instructions << ", "
+	   << "\"backpatches\": " << backpatches << ", "
+	   << "\"peak_instructions\": " << peakInstructions << ", "
+	   << "\"arena_blocks\": " << arenaBlocks << ", "
+	   << "\"arena_bytes\": " << arenaBytes << ", "
+	   << "\"removed_instructions\": " << removedInstructions << ", "
+	   << "\"slots_before\": " << slotsBefore << ", "
+	   << "\"slots_after\": " << slotsAfter
+	   << "}" << endl;
+}
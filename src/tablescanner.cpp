@@ -0,0 +1,97 @@
+#include "../headers/tablescanner.h"
+#include "milan_dfa.h"
+#include <algorithm>
+#include <iterator>
+
+TableScanner::TableScanner(const string& fileName, istream& input)
+	: Scanner(fileName, input, false)
+{
+	// У файла и строкового потока размер текста известен заранее: текст читается
+	// одним блоком, без перевыделения строки по мере ее роста
+	streambuf* buffer = input.rdbuf();
+	streamoff start = buffer->pubseekoff(0, ios::cur, ios::in);
+	if(start >= 0) {
+		streamoff end = buffer->pubseekoff(0, ios::end, ios::in);
+		buffer->pubseekpos(start, ios::in);
+		if(end > start) {
+			storage_.resize(end - start);
+			storage_.resize(buffer->sgetn(&storage_[0], end - start));
+		}
+	}
+	storage_.append(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	text_ = reinterpret_cast<const unsigned char*>(storage_.data());
+	pos_ = text_;
+	end_ = text_ + storage_.size();
+}
+
+TableScanner::TableScanner(const string& fileName, const string& text, size_t start)
+	: Scanner(fileName, noInput(), false)
+{
+	text_ = reinterpret_cast<const unsigned char*>(text.data());
+	pos_ = text_ + start;
+	end_ = text_ + text.size();
+}
+
+void TableScanner::nextToken()
+{
+	for(;;) {
+		if(pos_ == end_) {
+			tokenOffset_ = end_ - text_;
+			token_ = T_EOF;
+			return;
+		}
+
+		// Самое длинное совпадение: ДКА работает до тупикового состояния,
+		// запоминая последнее допускающее. Последнее правило спецификации
+		// допускает любой байт, поэтому совпадение есть всегда.
+		const unsigned char* p = pos_;
+		const unsigned char* matchEnd = pos_ + 1;
+		int state = MILAN_DFA_START;
+		int rule = 0;
+		while(p != end_) {
+			state = milanDfaNext[state][milanDfaClass[*p]];
+			if(state == 0) {
+				break;
+			}
+			++p;
+			if(int accepted = milanDfaAccept[state]) {
+				rule = accepted;
+				matchEnd = p;
+			}
+		}
+
+		const unsigned char* start = pos_;
+		pos_ = matchEnd;
+		tokenOffset_ = start - text_;
+
+		const MilanDfaRule& action = milanDfaRules[rule];
+		if(action.skip) {
+			lineNumber_ += count(start, matchEnd, '\n');
+			continue;
+		}
+
+		token_ = action.token;
+		cmpValue_ = static_cast<Cmp>(action.value);
+		arithmeticValue_ = static_cast<Arithmetic>(action.value);
+
+		if(token_ == T_EOF) {
+			// Незакрытый комментарий до конца текста
+			lineNumber_ += count(start, matchEnd, '\n');
+		}
+		else if(token_ == T_NUMBER) {
+			unsigned value = 0;
+			for(; start != matchEnd; ++start) {
+				value = value * 10 + (*start - '0');
+			}
+			intValue_ = value;
+		}
+		else if(token_ == T_IDENTIFIER) {
+			stringValue_.assign(start, matchEnd);
+			for(char& c : stringValue_) {
+				c |= 0x20;  // только латинские буквы и цифры, цифры не меняются
+			}
+			token_ = keywordOrIdentifier();
+		}
+		return;
+	}
+}
@@ -0,0 +1,180 @@
+#include "../headers/textscan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MILAN_TEXTSCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool isSpaceByte(unsigned char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+size_t whitespaceScalar(const char* p, size_t n, int& newlines)
+{
+	size_t i = 0;
+	while(i < n && isSpaceByte(p[i])) {
+		if(p[i] == '\n') {
+			++newlines;
+		}
+		++i;
+	}
+	return i;
+}
+
+size_t untilScalar(const char* p, size_t n, char c, int& newlines)
+{
+	size_t i = 0;
+	while(i < n && p[i] != c) {
+		if(p[i] == '\n') {
+			++newlines;
+		}
+		++i;
+	}
+	return i;
+}
+
+#ifdef MILAN_TEXTSCAN_X86
+
+// Пробельный байт: ' ' или код от '\t' до '\r'. Последнее проверяется одним
+// беззнаковым сравнением (b - '\t') <= 4 через min: min(t, 4) == t.
+
+#ifdef __SSE2__
+size_t whitespaceSse2(const char* p, size_t n, int& newlines)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i four = _mm_set1_epi8(4);
+	const __m128i newline = _mm_set1_epi8('\n');
+
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		__m128i shifted = _mm_sub_epi8(bytes, tab);
+		__m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+			_mm_cmpeq_epi8(_mm_min_epu8(shifted, four), shifted));
+		unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(spaces)) & 0xFFFFu;
+		unsigned lines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+		if(other != 0) {
+			unsigned stop = __builtin_ctz(other);
+			newlines += __builtin_popcount(lines & ((1u << stop) - 1));
+			return i + stop;
+		}
+		newlines += __builtin_popcount(lines);
+	}
+	return i + whitespaceScalar(p + i, n - i, newlines);
+}
+
+size_t untilSse2(const char* p, size_t n, char c, int& newlines)
+{
+	const __m128i target = _mm_set1_epi8(c);
+	const __m128i newline = _mm_set1_epi8('\n');
+
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		unsigned found = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, target)));
+		unsigned lines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+		if(found != 0) {
+			unsigned stop = __builtin_ctz(found);
+			newlines += __builtin_popcount(lines & ((1u << stop) - 1));
+			return i + stop;
+		}
+		newlines += __builtin_popcount(lines);
+	}
+	return i + untilScalar(p + i, n - i, c, newlines);
+}
+#endif
+
+__attribute__((target("avx2,popcnt")))
+size_t whitespaceAvx2(const char* p, size_t n, int& newlines)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i four = _mm256_set1_epi8(4);
+	const __m256i newline = _mm256_set1_epi8('\n');
+
+	size_t i = 0;
+	for(; i + 32 <= n; i += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		__m256i shifted = _mm256_sub_epi8(bytes, tab);
+		__m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space),
+			_mm256_cmpeq_epi8(_mm256_min_epu8(shifted, four), shifted));
+		unsigned other = ~static_cast<unsigned>(_mm256_movemask_epi8(spaces));
+		unsigned lines = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+		if(other != 0) {
+			unsigned stop = __builtin_ctz(other);
+			newlines += __builtin_popcount(lines & ((1u << stop) - 1));
+			return i + stop;
+		}
+		newlines += __builtin_popcount(lines);
+	}
+	return i + whitespaceScalar(p + i, n - i, newlines);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t untilAvx2(const char* p, size_t n, char c, int& newlines)
+{
+	const __m256i target = _mm256_set1_epi8(c);
+	const __m256i newline = _mm256_set1_epi8('\n');
+
+	size_t i = 0;
+	for(; i + 32 <= n; i += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		unsigned found = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, target)));
+		unsigned lines = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+		if(found != 0) {
+			unsigned stop = __builtin_ctz(found);
+			newlines += __builtin_popcount(lines & ((1u << stop) - 1));
+			return i + stop;
+		}
+		newlines += __builtin_popcount(lines);
+	}
+	return i + untilScalar(p + i, n - i, c, newlines);
+}
+
+#endif
+
+// Набор реализаций, выбранный для текущего процессора
+struct ScanKernels
+{
+	size_t (*whitespace)(const char*, size_t, int&);
+	size_t (*until)(const char*, size_t, char, int&);
+};
+
+ScanKernels selectKernels()
+{
+	ScanKernels kernels = { whitespaceScalar, untilScalar };
+#ifdef MILAN_TEXTSCAN_X86
+#ifdef __SSE2__
+	kernels.whitespace = whitespaceSse2;
+	kernels.until = untilSse2;
+#endif
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		kernels.whitespace = whitespaceAvx2;
+		kernels.until = untilAvx2;
+	}
+#endif
+	return kernels;
+}
+
+const ScanKernels& kernels()
+{
+	static const ScanKernels selected = selectKernels();
+	return selected;
+}
+
+}
+
+size_t scanWhitespace(const char* p, size_t n, int& newlines)
+{
+	return kernels().whitespace(p, n, newlines);
+}
+
+size_t scanUntil(const char* p, size_t n, char c, int& newlines)
+{
+	return kernels().until(p, n, c, newlines);
+}
@@ -0,0 +1,306 @@
+#include "../headers/tokenbuffer.h"
+#include "../headers/tablescanner.h"
+#include <algorithm>
+#include <thread>
+
+// Вызов work(k) для k от 0 до count - 1, каждый в своем потоке
+template<typename Work>
+static void runParallel(size_t count, Work work)
+{
+	vector<thread> workers;
+	for(size_t k = 0; k + 1 < count; ++k) {
+		workers.push_back(thread(work, k));
+	}
+	if(count > 0) {
+		work(count - 1);
+	}
+	for(thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// Часть текста для параллельного разбора
+struct TokenBuffer::Chunk
+{
+	size_t begin;        // Начало части (начало строки)
+	size_t end;          // Конец части; лексемы, начинающиеся не раньше end, относятся к следующим частям
+	size_t start;        // Позиция, с которой начат разбор (begin или позже)
+	size_t next;         // Начало первой лексемы за концом части; npos, если получена T_EOF
+	int newlines;        // Число переводов строки в части
+	int lineBase;        // Число переводов строки перед start
+	TokenBuffer tokens;  // Лексемы части; номера строк отсчитываются от start
+};
+
+TokenBuffer::TokenBuffer(Scanner& scanner)
+{
+	do {
+		scanner.nextToken();
+		push(scanner);
+	} while(scanner.token() != T_EOF);
+}
+
+TokenBuffer::TokenBuffer(const string& text, unsigned threads)
+{
+	if(threads == 0) {
+		threads = max(thread::hardware_concurrency(), 1u);
+	}
+	size_t chunkCount = min<size_t>(threads, max<size_t>(text.size() / MIN_CHUNK_SIZE, 1));
+
+	// Части заканчиваются после перевода строки, последняя - в конце текста
+	vector<Chunk> chunks;
+	size_t begin = 0;
+	for(size_t k = 1; k <= chunkCount; ++k) {
+		size_t end = string::npos;
+		if(k < chunkCount) {
+			end = text.find('\n', max(text.size() / chunkCount * k, begin));
+			if(end == string::npos) {
+				continue;
+			}
+			++end;
+		}
+
+		Chunk chunk;
+		chunk.begin = chunk.start = begin;
+		chunk.end = end;
+		chunk.next = string::npos;
+		chunk.newlines = 0;
+		chunk.lineBase = 0;
+		chunks.push_back(chunk);
+		begin = end;
+	}
+
+	// Спекулятивный разбор: каждая часть разбирается с начала, как будто перед
+	// ней нет незакрытого комментария
+	runParallel(chunks.size(), [&text, &chunks](size_t k) {
+		Chunk& chunk = chunks[k];
+		size_t end = min(chunk.end, text.size());
+		chunk.newlines = static_cast<int>(count(text.begin() + chunk.begin, text.begin() + end, '\n'));
+		lexChunk(text, chunk, NULL);
+	});
+
+	for(size_t k = 1; k < chunks.size(); ++k) {
+		chunks[k].lineBase = chunks[k - 1].lineBase + chunks[k - 1].newlines;
+	}
+
+	// Проверка частей. next - начало следующей лексемы настоящего разбора: если в
+	// части нет лексемы, начинающейся в next, часть начинается внутри комментария и
+	// разбирается заново с next до первой лексемы, общей со спекулятивным разбором.
+	// Лишние лексемы в начале части отбрасываются.
+	vector<Chunk*> parts;
+	size_t next = 0;
+	for(Chunk& chunk : chunks) {
+		if(next == string::npos) {
+			break;
+		}
+		if(next >= chunk.end) {
+			continue;
+		}
+
+		size_t first = 0;
+		if(next != chunk.start) {
+			first = chunk.tokens.find(next);
+			if(first == chunk.tokens.size()) {
+				Chunk fixed;
+				fixed.begin = chunk.begin;
+				fixed.end = chunk.end;
+				fixed.start = next;
+				fixed.next = string::npos;
+				fixed.newlines = chunk.newlines;
+				fixed.lineBase = chunk.lineBase +
+					static_cast<int>(count(text.begin() + chunk.start, text.begin() + next, '\n'));
+				lexChunk(text, fixed, &chunk);
+				chunk = move(fixed);
+				first = 0;
+			}
+		}
+
+		if(first > 0) {
+			TokenBuffer rest;
+			rest.append(chunk.tokens, first, chunk.tokens.size(), 0);
+			chunk.tokens = move(rest);
+		}
+		parts.push_back(&chunk);
+		next = chunk.next;
+	}
+
+	merge(parts);
+}
+
+// Склейка частей. Имена каждой части перечислены в порядке первого появления,
+// поэтому их номера в общей таблице получаются последовательно; массивы лексем
+// копируются параллельно, отрезки номеров строк - последовательно.
+void TokenBuffer::merge(const vector<Chunk*>& parts)
+{
+	if(parts.size() == 1 && parts[0]->lineBase == 0) {
+		*this = move(parts[0]->tokens);
+		return;
+	}
+
+	vector<vector<int>> names(parts.size());
+	vector<size_t> bases(parts.size() + 1, 0);
+	for(size_t k = 0; k < parts.size(); ++k) {
+		const TokenBuffer& tokens = parts[k]->tokens;
+		for(const string& name : tokens.names_) {
+			names[k].push_back(intern(name));
+		}
+		bases[k + 1] = bases[k] + tokens.size();
+
+		for(size_t run = 0; run < tokens.lineTokens_.size(); ++run) {
+			int line = tokens.lineNumbers_[run] + parts[k]->lineBase;
+			if(lineNumbers_.empty() || lineNumbers_.back() != line) {
+				lineTokens_.push_back(static_cast<uint32_t>(bases[k] + tokens.lineTokens_[run]));
+				lineNumbers_.push_back(line);
+			}
+		}
+	}
+
+	kinds_.resize(bases.back());
+	payloads_.resize(bases.back());
+	offsets_.resize(bases.back());
+	runParallel(parts.size(), [this, &parts, &names, &bases](size_t k) {
+		const TokenBuffer& tokens = parts[k]->tokens;
+		size_t base = bases[k];
+		copy(tokens.kinds_.begin(), tokens.kinds_.end(), kinds_.begin() + base);
+		copy(tokens.offsets_.begin(), tokens.offsets_.end(), offsets_.begin() + base);
+		for(size_t i = 0; i < tokens.size(); ++i) {
+			int32_t payload = tokens.payloads_[i];
+			payloads_[base + i] = tokens.kinds_[i] == T_IDENTIFIER ? names[k][payload] : payload;
+		}
+	});
+}
+
+// Разбор части с позиции chunk.start до первой лексемы, начинающейся не раньше
+// chunk.end, или до T_EOF. Если задан speculative (спекулятивный разбор той же
+// части), разбор останавливается на первой лексеме, которая есть в speculative,
+// а остальные лексемы берутся оттуда: с одной и той же позиции ДКА
+// разбирает текст одинаково.
+void TokenBuffer::lexChunk(const string& text, Chunk& chunk, const Chunk* speculative)
+{
+	TableScanner scanner("", text, chunk.start);
+	size_t sync = 0;
+	for(;;) {
+		scanner.nextToken();
+		size_t offset = scanner.getTokenOffset();
+		if(offset >= chunk.end) {
+			chunk.next = offset;
+			return;
+		}
+
+		if(speculative) {
+			const TokenBuffer& tokens = speculative->tokens;
+			while(sync < tokens.size() && tokens.offsets_[sync] < offset) {
+				++sync;
+			}
+			if(sync < tokens.size() && tokens.offsets_[sync] == offset) {
+				chunk.tokens.append(tokens, sync, tokens.size(), speculative->lineBase - chunk.lineBase);
+				chunk.next = speculative->next;
+				return;
+			}
+		}
+
+		chunk.tokens.push(scanner);
+		if(scanner.token() == T_EOF) {
+			chunk.next = string::npos;
+			return;
+		}
+	}
+}
+
+void TokenBuffer::push(const Scanner& scanner)
+{
+	Token token = scanner.token();
+	int32_t payload = 0;
+	switch(token) {
+		case T_NUMBER:
+			payload = scanner.getIntValue();
+			break;
+		case T_CMP:
+			payload = scanner.getCmpValue();
+			break;
+		case T_ADDOP:
+		case T_MULOP:
+			payload = scanner.getArithmeticValue();
+			break;
+		case T_IDENTIFIER:
+			payload = intern(scanner.getStringValue());
+			break;
+		default:
+			break;
+	}
+
+	addLine(scanner.getLineNumber());
+	kinds_.push_back(static_cast<uint8_t>(token));
+	payloads_.push_back(payload);
+	offsets_.push_back(static_cast<uint32_t>(scanner.getTokenOffset()));
+}
+
+void TokenBuffer::append(const TokenBuffer& from, size_t first, size_t last, int lineShift)
+{
+	if(first >= last) {
+		return;
+	}
+
+	size_t base = kinds_.size();
+	kinds_.insert(kinds_.end(), from.kinds_.begin() + first, from.kinds_.begin() + last);
+	offsets_.insert(offsets_.end(), from.offsets_.begin() + first, from.offsets_.begin() + last);
+
+	// Имена переводятся в номера этого буфера по первому появлению
+	vector<int> names(from.names_.size(), -1);
+	payloads_.reserve(payloads_.size() + (last - first));
+	for(size_t i = first; i < last; ++i) {
+		int32_t payload = from.payloads_[i];
+		if(from.kinds_[i] == T_IDENTIFIER) {
+			if(names[payload] < 0) {
+				names[payload] = intern(from.names_[payload]);
+			}
+			payload = names[payload];
+		}
+		payloads_.push_back(payload);
+	}
+
+	size_t run = upper_bound(from.lineTokens_.begin(), from.lineTokens_.end(), first) - from.lineTokens_.begin() - 1;
+	for(; run < from.lineTokens_.size() && from.lineTokens_[run] < last; ++run) {
+		size_t token = max<size_t>(from.lineTokens_[run], first);
+		if(lineNumbers_.empty() || lineNumbers_.back() != from.lineNumbers_[run] + lineShift) {
+			lineTokens_.push_back(static_cast<uint32_t>(base + token - first));
+			lineNumbers_.push_back(from.lineNumbers_[run] + lineShift);
+		}
+	}
+}
+
+int TokenBuffer::intern(const string& name)
+{
+	// Сначала поиск: emplace() создает узел (и копию имени) даже для известного имени
+	unordered_map<string, int>::const_iterator it = nameIndex_.find(name);
+	if(it != nameIndex_.end()) {
+		return it->second;
+	}
+	int index = static_cast<int>(names_.size());
+	nameIndex_.emplace(name, index);
+	names_.push_back(name);
+	return index;
+}
+
+void TokenBuffer::addLine(int line)
+{
+	if(lineNumbers_.empty() || lineNumbers_.back() != line) {
+		lineTokens_.push_back(static_cast<uint32_t>(kinds_.size()));
+		lineNumbers_.push_back(line);
+	}
+}
+
+size_t TokenBuffer::find(size_t offset) const
+{
+	vector<uint32_t>::const_iterator it = lower_bound(offsets_.begin(), offsets_.end(), offset);
+	if(it == offsets_.end() || *it != offset) {
+		return size();
+	}
+	return it - offsets_.begin();
+}
+
+int TokenBuffer::lineNumber(size_t i) const
+{
+	// Последний отрезок, начинающийся не позже лексемы i
+	size_t run = upper_bound(lineTokens_.begin(), lineTokens_.end(), i) - lineTokens_.begin() - 1;
+	return lineNumbers_[run];
+}
@@ -0,0 +1,253 @@
+// Проверка числа выделений памяти из кучи при трансляции.
+//
+// Использование: milan_alloccount [--small=N] [--large=N]
+//
+// Глобальные operator new/delete заменены считающими. Программы из small и
+// large операторов (по умолчанию 1000 и 100000) транслируются в каждом режиме,
+// и сравнивается число вызовов operator new за трансляцию. Блоки арены Parser
+// (CompileOptions::memory) считаются отдельно:
+//   - выделения помимо арены не должны зависеть от размера программы;
+//   - в потоковом режиме (--emit=stream) не должно зависеть и число блоков
+//     арены. Без него программа хранится целиком, и арена берет блоки
+//     растущего размера: их число растет как логарифм размера программы.
+// Если условие нарушено, milan_alloccount завершается с ненулевым кодом.
+//
+// Не проверяются режимы, в которых память по-прежнему берется из кучи мимо
+// арены: --tokens=buffer и --tokens=parallel (внутренние массивы TokenBuffer),
+// --pipeline (пакеты лексем PipelineScanner), --compile=parallel (арены частей)
+// и --optimize (рабочие таблицы Optimizer).
+
+#include "../headers/parser.h"
+#include "../headers/stats.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+	++allocations;
+	void* p = malloc(size ? size : 1);
+	if(!p) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// pmr::new_delete_resource (источник блоков арены) вызывает варианты с выравниванием
+void* operator new(size_t size, align_val_t alignment)
+{
+	++allocations;
+	size_t align = static_cast<size_t>(alignment);
+	void* p = aligned_alloc(align, (size + align - 1) / align * align);
+	if(!p) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* p, align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t, align_val_t) noexcept
+{
+	free(p);
+}
+
+// Поток, отбрасывающий все, что в него пишут
+class NullBuffer : public streambuf
+{
+public:
+	NullBuffer()
+	{
+		setp(buffer_, buffer_ + sizeof(buffer_));
+	}
+
+protected:
+	virtual int overflow(int c)
+	{
+		setp(buffer_, buffer_ + sizeof(buffer_));
+		if(c != traits_type::eof()) {
+			sputc(static_cast<char>(c));
+		}
+		return 0;
+	}
+
+private:
+	char buffer_[4096];
+};
+
+// Программа примерно из size операторов: присваивания, ветвления, циклы while и
+// for, case и вывод над фиксированным набором переменных
+static string program(size_t size)
+{
+	ostringstream text;
+	text << "BEGIN\n";
+	for(size_t i = 0; i < size; ++i) {
+		int a = i % 16;
+		int b = (i * 7 + 3) % 16;
+		switch(i % 6) {
+			case 0:
+				text << "X" << a << " := X" << b << " * " << i % 97 << " + (X" << a << " - 3) / 2;\n";
+				break;
+			case 1:
+				text << "IF X" << a << " < X" << b << " THEN X" << a << " := X" << b << " ELSE X" << b << " := 1 FI;\n";
+				break;
+			case 2:
+				text << "WHILE X" << a << " > 100 DO X" << a << " := X" << a << " / 2 OD;\n";
+				break;
+			case 3:
+				text << "FOR I := 1 TO X" << b << " STEP 2 DO X" << a << " := X" << a << " + I OD;\n";
+				break;
+			case 4:
+				text << "CASE X" << a << " OF 1: X" << b << " := 2; 2: X" << b << " := 3; 3: WRITE(X" << a << ") ESAC;\n";
+				break;
+			default:
+				text << "WRITE(X" << a << ");\n";
+				break;
+		}
+	}
+	text << "WRITE(0)\nEND\n";
+	return text.str();
+}
+
+// Выделения памяти за одну трансляцию
+struct Allocations {
+	size_t heap;     // Вызовов operator new, кроме блоков арены
+	size_t arena;    // Блоков арены
+	bool errors;     // В программе найдены ошибки
+};
+
+// Трансляция текста text с подсчетом выделений (входной поток не учитывается)
+static Allocations countAllocations(const string& text, const CompileOptions& base)
+{
+	NullBuffer buffer;
+	ostream output(&buffer);
+	istringstream input(text);
+	CountingResource arena(pmr::new_delete_resource());
+	CompileOptions options = base;
+	options.output = &output;
+	options.memory = &arena;
+
+	Allocations result;
+	size_t before = allocations;
+	{
+		Parser parser("alloccount", input, options);
+		parser.parse();
+		result.errors = parser.hasErrors();
+	}
+	result.arena = arena.blocks();
+	result.heap = allocations - before - result.arena;
+	return result;
+}
+
+struct Mode {
+	const char* name;
+	bool tableScanner;
+	bool ll1Parser;
+	bool streamOutput;
+};
+
+static const Mode MODES[] = {
+	{ "default", false, false, false },
+	{ "--scanner=table", true, false, false },
+	{ "--parser=ll1", false, true, false },
+	{ "--emit=stream", false, false, true },
+	{ "--scanner=table --parser=ll1 --emit=stream", true, true, true },
+};
+
+int main(int argc, char** argv)
+{
+	size_t small = 1000;
+	size_t large = 100000;
+	for(int i = 1; i < argc; ++i) {
+		if(strncmp(argv[i], "--small=", 8) == 0) {
+			small = strtoul(argv[i] + 8, NULL, 10);
+		}
+		else if(strncmp(argv[i], "--large=", 8) == 0) {
+			large = strtoul(argv[i] + 8, NULL, 10);
+		}
+		else {
+			cerr << "Usage: milan_alloccount [--small=N] [--large=N]" << endl;
+			return 2;
+		}
+	}
+
+	string smallText = program(small);
+	string largeText = program(large);
+
+	int failures = 0;
+	for(const Mode& mode : MODES) {
+		CompileOptions options;
+		options.tableScanner = mode.tableScanner;
+		options.ll1Parser = mode.ll1Parser;
+		options.streamOutput = mode.streamOutput;
+
+		// Пробная трансляция: статические таблицы и буферы библиотеки создаются один раз
+		countAllocations(smallText, options);
+
+		Allocations smallCount = countAllocations(smallText, options);
+		Allocations largeCount = countAllocations(largeText, options);
+
+		bool ok = !smallCount.errors && !largeCount.errors && smallCount.heap == largeCount.heap
+				  && (!mode.streamOutput || smallCount.arena == largeCount.arena);
+		cout << (ok ? "ok   " : "FAIL ") << mode.name << ": " << small << " statements - "
+			 << smallCount.heap << " allocations and " << smallCount.arena << " arena blocks, "
+			 << large << " statements - " << largeCount.heap << " and " << largeCount.arena << endl;
+		if(smallCount.errors || largeCount.errors) {
+			cout << "     program has errors" << endl;
+		}
+		if(!ok) {
+			++failures;
+		}
+	}
+	return failures ? 1 : 0;
+}
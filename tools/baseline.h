@@ -0,0 +1,297 @@
+#ifndef CMILAN_BASELINE_H
+#define CMILAN_BASELINE_H
+
+// Сравнение результатов milan_bench с сохраненным базовым запуском.
+//
+// Базовый запуск - JSON, записанный самим milan_bench (--out). Из него читаются
+// только имена замеров и времена запусков (samples), поэтому разбор JSON здесь
+// минимальный: объекты, массивы, строки без \u, числа, true/false/null.
+// Замеры сравниваются U-критерием Манна-Уитни (двусторонним, нормальное
+// приближение с поправками на совпадения и непрерывность): он не предполагает
+// нормального распределения времени и устойчив к отдельным выбросам.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct JsonValue
+{
+	enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+	Type type;
+	bool flag;
+	double number;
+	string text;
+	vector<JsonValue> items;                  // ARRAY
+	vector<pair<string, JsonValue> > fields;  // OBJECT
+
+	JsonValue()
+		: type(NUL), flag(false), number(0)
+	{}
+
+	// Поле объекта; NULL, если его нет
+	const JsonValue* field(const string& name) const
+	{
+		for(const pair<string, JsonValue>& f : fields) {
+			if(f.first == name) {
+				return &f.second;
+			}
+		}
+		return NULL;
+	}
+};
+
+class JsonReader
+{
+public:
+	explicit JsonReader(const string& text)
+		: text_(text), pos_(0)
+	{}
+
+	// Разбор всего текста; false при синтаксической ошибке
+	bool read(JsonValue& value)
+	{
+		if(!parse(value)) {
+			return false;
+		}
+		skipSpace();
+		return pos_ == text_.size();
+	}
+
+private:
+	void skipSpace()
+	{
+		while(pos_ < text_.size() && isspace(static_cast<unsigned char>(text_[pos_]))) {
+			++pos_;
+		}
+	}
+
+	bool literal(const char* word)
+	{
+		size_t length = char_traits<char>::length(word);
+		if(text_.compare(pos_, length, word) != 0) {
+			return false;
+		}
+		pos_ += length;
+		return true;
+	}
+
+	bool parseString(string& result)
+	{
+		++pos_;  // открывающая кавычка
+		result.clear();
+		while(pos_ < text_.size() && text_[pos_] != '"') {
+			if(text_[pos_] == '\\') {
+				if(++pos_ == text_.size()) {
+					return false;
+				}
+				char c = text_[pos_];
+				result += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+			}
+			else {
+				result += text_[pos_];
+			}
+			++pos_;
+		}
+		if(pos_ == text_.size()) {
+			return false;
+		}
+		++pos_;
+		return true;
+	}
+
+	bool parse(JsonValue& value)
+	{
+		skipSpace();
+		if(pos_ == text_.size()) {
+			return false;
+		}
+
+		char c = text_[pos_];
+		if(c == '{') {
+			value.type = JsonValue::OBJECT;
+			++pos_;
+			skipSpace();
+			if(pos_ < text_.size() && text_[pos_] == '}') {
+				++pos_;
+				return true;
+			}
+			for(;;) {
+				skipSpace();
+				pair<string, JsonValue> field;
+				if(pos_ == text_.size() || text_[pos_] != '"' || !parseString(field.first)) {
+					return false;
+				}
+				skipSpace();
+				if(pos_ == text_.size() || text_[pos_] != ':') {
+					return false;
+				}
+				++pos_;
+				if(!parse(field.second)) {
+					return false;
+				}
+				value.fields.push_back(field);
+				skipSpace();
+				if(pos_ < text_.size() && text_[pos_] == ',') {
+					++pos_;
+					continue;
+				}
+				if(pos_ < text_.size() && text_[pos_] == '}') {
+					++pos_;
+					return true;
+				}
+				return false;
+			}
+		}
+		if(c == '[') {
+			value.type = JsonValue::ARRAY;
+			++pos_;
+			skipSpace();
+			if(pos_ < text_.size() && text_[pos_] == ']') {
+				++pos_;
+				return true;
+			}
+			for(;;) {
+				JsonValue item;
+				if(!parse(item)) {
+					return false;
+				}
+				value.items.push_back(item);
+				skipSpace();
+				if(pos_ < text_.size() && text_[pos_] == ',') {
+					++pos_;
+					continue;
+				}
+				if(pos_ < text_.size() && text_[pos_] == ']') {
+					++pos_;
+					return true;
+				}
+				return false;
+			}
+		}
+		if(c == '"') {
+			value.type = JsonValue::STRING;
+			return parseString(value.text);
+		}
+		if(literal("true")) {
+			value.type = JsonValue::BOOLEAN;
+			value.flag = true;
+			return true;
+		}
+		if(literal("false")) {
+			value.type = JsonValue::BOOLEAN;
+			return true;
+		}
+		if(literal("null")) {
+			value.type = JsonValue::NUL;
+			return true;
+		}
+
+		const char* start = text_.c_str() + pos_;
+		char* end = NULL;
+		value.type = JsonValue::NUMBER;
+		value.number = strtod(start, &end);
+		if(end == start) {
+			return false;
+		}
+		pos_ += end - start;
+		return true;
+	}
+
+	const string& text_;
+	size_t pos_;
+};
+
+// Чтение базового запуска: имя замера - времена запусков. false, если файл
+// не читается или не похож на результат milan_bench.
+inline bool loadBaseline(const string& fileName, map<string, vector<double> >& samples)
+{
+	ifstream input(fileName.c_str());
+	if(!input) {
+		return false;
+	}
+	string text((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+	JsonValue root;
+	if(!JsonReader(text).read(root)) {
+		return false;
+	}
+	const JsonValue* benchmarks = root.field("benchmarks");
+	if(benchmarks == NULL || benchmarks->type != JsonValue::ARRAY) {
+		return false;
+	}
+	for(const JsonValue& b : benchmarks->items) {
+		const JsonValue* name = b.field("name");
+		const JsonValue* values = b.field("samples");
+		if(name == NULL || values == NULL || values->type != JsonValue::ARRAY) {
+			return false;
+		}
+		vector<double>& times = samples[name->text];
+		for(const JsonValue& v : values->items) {
+			times.push_back(v.number);
+		}
+	}
+	return true;
+}
+
+// Двустороннее p-значение U-критерия Манна-Уитни для выборок a и b
+inline double mannWhitneyP(const vector<double>& a, const vector<double>& b)
+{
+	size_t n1 = a.size();
+	size_t n2 = b.size();
+	if(n1 == 0 || n2 == 0) {
+		return 1;
+	}
+
+	// Ранги объединенной выборки; совпадающим значениям - средний ранг
+	vector<pair<double, int> > all;
+	for(double v : a) {
+		all.push_back(make_pair(v, 0));
+	}
+	for(double v : b) {
+		all.push_back(make_pair(v, 1));
+	}
+	sort(all.begin(), all.end());
+
+	size_t n = all.size();
+	double rankSumA = 0;
+	double ties = 0;  // сумма t^3 - t по группам совпадений
+	for(size_t i = 0; i < n;) {
+		size_t j = i;
+		while(j < n && all[j].first == all[i].first) {
+			++j;
+		}
+		double rank = (i + 1 + j) / 2.0;
+		for(size_t k = i; k < j; ++k) {
+			if(all[k].second == 0) {
+				rankSumA += rank;
+			}
+		}
+		double t = double(j - i);
+		ties += t * t * t - t;
+		i = j;
+	}
+
+	double u = rankSumA - n1 * (n1 + 1) / 2.0;
+	double mean = n1 * n2 / 2.0;
+	double variance = n1 * n2 / 12.0 * ((n + 1) - ties / (double(n) * (n - 1)));
+	if(variance <= 0) {
+		return 1;
+	}
+	double z = (fabs(u - mean) - 0.5) / sqrt(variance);
+	if(z < 0) {
+		z = 0;
+	}
+	return erfc(z / sqrt(2.0));
+}
+
+#endif
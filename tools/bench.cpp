@@ -0,0 +1,731 @@
+// Замеры производительности транслятора Милана.
+//
+// Использование: milan_bench [--runs=N] [--warmup=N] [--size=N] [--seed=N] [--only=ВИД] [--out=файл.json]
+//                            [--programs=каталог] [--baseline=файл.json] [--threshold=%] [--alpha=p]
+//                milan_bench --generate=ВИД [--size=N] [--seed=N]
+//
+// Программы генерируются по начальному значению seed, поэтому одинаковые
+// параметры дают одинаковые тексты на любой машине. Виды программ:
+//   straight  - длинная последовательность присваиваний
+//   nested    - глубоко вложенные if/while
+//   variables - тысячи различных переменных
+//   comments  - текст, в котором комментариев больше, чем кода
+//   boolean   - условия из &&, ||, !, &, |
+// Для каждого вида измеряются лексический анализ (Scanner), разбор с генерацией
+// кода (Parser по заранее прочитанным лексемам) и вывод программы (CodeGen::flush).
+// Каждый замер повторяется runs раз после warmup пробных запусков; в JSON
+// записываются медиана, среднее, дисперсия и минимум времени, а если доступны
+// аппаратные счетчики (perfcounters.h) - их медианы, такты на лексему или
+// инструкцию и число инструкций процессора за такт.
+// Кроме того, целиком (чтение лексем, разбор, вывод) транслируется каждая
+// программа *.mil из каталога --programs (по умолчанию test/ исходного дерева);
+// программы с ошибками пропускаются. Маленькая программа транслируется в одном
+// запуске столько раз, чтобы запуск длился не меньше PROGRAM_RUN_SECONDS.
+// Затем программа выполняется на виртуальной машине (vm.h) без оптимизации и
+// с --optimize, числа для READ берутся из VM_INPUT; для выполнения в JSON
+// записывается число выполненных инструкций машины и такты на одну инструкцию.
+// --only выбирает один вид программ или programs.
+//
+// Результат (--out) можно сохранить как базовый и передать следующему запуску
+// в --baseline: каждый замер сравнивается с базовым (baseline.h), и если медиана
+// времени выросла больше чем на threshold процентов (по умолчанию 5) при
+// p-значении U-критерия меньше alpha (по умолчанию 0.05), замер считается
+// регрессией и milan_bench завершается с ненулевым кодом.
+//
+// --generate печатает программу указанного вида и ничего не измеряет.
+
+#include "../headers/parser.h"
+#include "../headers/stats.h"
+#include "baseline.h"
+#include "perfcounters.h"
+#include "vm.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#ifndef MILAN_TEST_DIR
+#define MILAN_TEST_DIR "test"
+#endif
+
+static const char* const KINDS[] = { "straight", "nested", "variables", "comments", "boolean" };
+
+static const double PROGRAM_RUN_SECONDS = 0.002;
+
+// Числа для INPUT при выполнении программ на виртуальной машине
+static const char* const VM_INPUT = "10000 3 10000 3 10000 3 10000 3";
+
+// Генератор программ. Случайные числа - xorshift64*, чтобы последовательность
+// не зависела от реализации стандартной библиотеки.
+class Generator
+{
+public:
+	explicit Generator(uint64_t seed)
+		: state_(seed * 2 + 1), statements_(0), variables_(32)
+	{}
+
+	// Программа вида kind примерно из size операторов; пустая строка для неизвестного вида
+	string program(const string& kind, size_t size)
+	{
+		text_ = "begin\n";
+		statements_ = 0;
+		variables_ = 32;
+		bool first = true;
+		while(statements_ < size) {
+			if(!first) {
+				text_ += ";\n";
+			}
+			first = false;
+
+			if(kind == "straight") {
+				assignment();
+			}
+			else if(kind == "nested") {
+				nested(1 + below(64));
+			}
+			else if(kind == "variables") {
+				variables_ = 4096 + static_cast<int>(size / 8);
+				text_ += variable() + " := " + variable() + " + " + number(1000);
+				++statements_;
+			}
+			else if(kind == "comments") {
+				comment();
+				assignment();
+				if(below(4) == 0) {
+					comment();
+				}
+			}
+			else if(kind == "boolean") {
+				text_ += "if ";
+				booleanExpression(3);
+				text_ += " then ";
+				assignment();
+				text_ += " else ";
+				assignment();
+				text_ += " fi";
+				++statements_;
+			}
+			else {
+				return string();
+			}
+		}
+		text_ += "\nend\n";
+		return text_;
+	}
+
+private:
+	uint64_t next()
+	{
+		state_ ^= state_ >> 12;
+		state_ ^= state_ << 25;
+		state_ ^= state_ >> 27;
+		return state_ * 2685821657736338717ull;
+	}
+
+	int below(int n)
+	{
+		return static_cast<int>(next() % static_cast<uint64_t>(n));
+	}
+
+	string variable()
+	{
+		return "v" + to_string(below(variables_));
+	}
+
+	string number(int limit)
+	{
+		return to_string(below(limit));
+	}
+
+	// Арифметическое выражение глубины не больше depth
+	void arithmetic(int depth)
+	{
+		if(depth == 0 || below(3) == 0) {
+			text_ += below(3) == 0 ? number(100) : variable();
+			return;
+		}
+		static const char* const ops[] = { " + ", " - ", " * ", " / " };
+		bool parens = below(4) == 0;
+		if(parens) {
+			text_ += "(";
+		}
+		arithmetic(depth - 1);
+		text_ += ops[below(4)];
+		arithmetic(depth - 1);
+		if(parens) {
+			text_ += ")";
+		}
+	}
+
+	void comparison()
+	{
+		static const char* const ops[] = { " < ", " > ", " <= ", " >= ", " = ", " != " };
+		arithmetic(1);
+		text_ += ops[below(6)];
+		arithmetic(1);
+	}
+
+	void booleanExpression(int depth)
+	{
+		int choice = depth == 0 ? 0 : below(6);
+		if(choice == 0) {
+			comparison();
+		}
+		else if(choice == 1) {
+			text_ += "!(";
+			booleanExpression(depth - 1);
+			text_ += ")";
+		}
+		else {
+			static const char* const ops[] = { " && ", " || ", " & ", " | " };
+			text_ += "(";
+			booleanExpression(depth - 1);
+			text_ += ops[below(4)];
+			booleanExpression(depth - 1);
+			text_ += ")";
+		}
+	}
+
+	void assignment()
+	{
+		text_ += variable() + " := ";
+		arithmetic(3);
+		++statements_;
+	}
+
+	// Вложенность depth: каждый уровень - if или while с присваиванием и следующим уровнем
+	void nested(int depth)
+	{
+		if(depth == 0) {
+			assignment();
+			return;
+		}
+		++statements_;
+		if(below(2) == 0) {
+			text_ += "if ";
+			comparison();
+			text_ += " then\n";
+			assignment();
+			text_ += ";\n";
+			nested(depth - 1);
+			text_ += "\nelse\n";
+			assignment();
+			text_ += "\nfi";
+		}
+		else {
+			text_ += "while ";
+			comparison();
+			text_ += " do\n";
+			nested(depth - 1);
+			text_ += ";\n";
+			assignment();
+			if(below(8) == 0) {
+				text_ += ";\nbreak";
+			}
+			text_ += "\nod";
+		}
+	}
+
+	void comment()
+	{
+		static const char* const words[] = { "lorem", "ipsum", "dolor", "sit", "amet", "milan", "stack", "machine" };
+		text_ += "/*";
+		int lines = 1 + below(3);
+		for(int line = 0; line < lines; ++line) {
+			for(int word = 0; word < 10; ++word) {
+				text_ += ' ';
+				text_ += words[below(8)];
+			}
+			text_ += '\n';
+		}
+		text_ += "*/ ";
+	}
+
+	uint64_t state_;
+	string text_;
+	size_t statements_;
+	int variables_;
+};
+
+// Поток вывода, который форматирует текст в буфер и выбрасывает его, как
+// буферизованный файл на очень быстром диске
+class NullBuffer : public streambuf
+{
+public:
+	NullBuffer()
+	{
+		setp(buffer_, buffer_ + sizeof(buffer_));
+	}
+
+protected:
+	virtual int overflow(int c)
+	{
+		setp(buffer_, buffer_ + sizeof(buffer_));
+		if(c != traits_type::eof()) {
+			sputc(static_cast<char>(c));
+		}
+		return traits_type::not_eof(c);
+	}
+
+private:
+	char buffer_[65536];
+};
+
+// Результаты одного замера
+struct Benchmark
+{
+	string name;
+	vector<double> seconds;  // Время каждого запуска
+	vector<uint64_t> counters[PerfCounters::EVENT_COUNT]; // Значения счетчиков каждого запуска
+	size_t bytes;            // Байт текста на запуск
+	size_t items;            // Лексем или инструкций на запуск
+	const char* itemName;    // "token" или "instruction"
+
+	Benchmark(const string& benchmarkName, size_t textBytes, const char* item)
+		: name(benchmarkName), bytes(textBytes), items(0), itemName(item)
+	{}
+
+	// Запись результатов запуска: время и показания счетчиков после stop()
+	void record(double runSeconds, const PerfCounters& perf)
+	{
+		seconds.push_back(runSeconds);
+		for(int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+			PerfCounters::Event event = static_cast<PerfCounters::Event>(e);
+			if(perf.has(event)) {
+				counters[e].push_back(perf.value(event));
+			}
+		}
+	}
+};
+
+template<typename T>
+static double median(vector<T> values)
+{
+	sort(values.begin(), values.end());
+	size_t n = values.size();
+	return n % 2 ? double(values[n / 2]) : (double(values[n / 2 - 1]) + double(values[n / 2])) / 2;
+}
+
+static void printJson(ostream& os, const vector<Benchmark>& results, uint64_t seed, size_t size, int runs,
+		bool countersAvailable)
+{
+	os << "{\n  \"seed\": " << seed << ", \"size\": " << size << ", \"runs\": " << runs
+	   << ", \"counters_available\": " << (countersAvailable ? "true" : "false") << ",\n";
+	os << "  \"benchmarks\": [\n";
+	for(size_t i = 0; i < results.size(); ++i) {
+		const Benchmark& b = results[i];
+		size_t n = b.seconds.size();
+		double middle = median(b.seconds);
+		double mean = 0;
+		for(double s : b.seconds) {
+			mean += s;
+		}
+		mean /= n;
+		double variance = 0;
+		for(double s : b.seconds) {
+			variance += (s - mean) * (s - mean);
+		}
+		variance = n > 1 ? variance / (n - 1) : 0;
+
+		os << "    {\"name\": \"" << b.name << "\", \"median_seconds\": " << middle
+		   << ", \"mean_seconds\": " << mean << ", \"variance\": " << variance
+		   << ", \"min_seconds\": " << *min_element(b.seconds.begin(), b.seconds.end())
+		   << ", \"bytes\": " << b.bytes << ", \"" << b.itemName << "s\": " << b.items
+		   << ", \"mb_per_second\": " << (middle > 0 ? double(b.bytes) / middle / 1e6 : 0)
+		   << ", \"" << b.itemName << "s_per_second\": " << (middle > 0 ? double(b.items) / middle : 0);
+
+		// Медианы счетчиков и производные величины
+		const vector<uint64_t>& cycles = b.counters[PerfCounters::CYCLES];
+		const vector<uint64_t>& instructions = b.counters[PerfCounters::INSTRUCTIONS];
+		if(!cycles.empty() && b.items > 0) {
+			os << ", \"cycles_per_" << b.itemName << "\": " << median(cycles) / double(b.items);
+		}
+		if(!cycles.empty() && !instructions.empty() && median(cycles) > 0) {
+			os << ", \"ipc\": " << median(instructions) / median(cycles);
+		}
+		os << ", \"counters\": {";
+		bool first = true;
+		for(int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+			if(!b.counters[e].empty()) {
+				os << (first ? "" : ", ") << "\"" << PerfCounters::name(static_cast<PerfCounters::Event>(e))
+				   << "\": " << static_cast<uint64_t>(median(b.counters[e]));
+				first = false;
+			}
+		}
+		os << "}, \"samples\": [";
+		for(size_t k = 0; k < b.seconds.size(); ++k) {
+			os << (k ? ", " : "") << b.seconds[k];
+		}
+		os << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	os << "  ]\n}" << endl;
+}
+
+// Лексический анализ всего текста: время, счетчики и число лексем
+static void lexOnce(const string& text, PerfCounters& perf, Benchmark& lex, bool record)
+{
+	istringstream input(text);
+	size_t tokens = 0;
+	perf.start();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Scanner scanner("bench", input);
+	do {
+		scanner.nextToken();
+		++tokens;
+	} while(scanner.token() != T_EOF);
+	double seconds = secondsSince(start);
+	perf.stop();
+
+	if(record) {
+		lex.record(seconds, perf);
+		lex.items = tokens;
+	}
+}
+
+// Трансляция по заранее прочитанным лексемам: разбор с генерацией кода и вывод
+// программы замеряются отдельно. Возвращает false, если в программе есть ошибки.
+static bool compileOnce(const string& text, PerfCounters& perf, Benchmark& parse, Benchmark& flush, bool record)
+{
+	istringstream input(text);
+	NullBuffer buffer;
+	ostream output(&buffer);
+	CompileOptions options;
+	options.tokenBuffer = true;
+	options.stats = true;
+	options.output = &output;
+	Parser parser("bench", input, options);
+
+	perf.start();
+	parser.compile();
+	perf.stop();
+	if(parser.hasErrors()) {
+		return false;
+	}
+	if(record) {
+		parse.record(parser.stats().parseSeconds, perf);
+		parse.items = parser.stats().instructions;
+	}
+
+	perf.start();
+	parser.writeProgram();
+	perf.stop();
+	if(record) {
+		flush.record(parser.stats().flushSeconds, perf);
+		flush.items = parser.stats().instructions;
+	}
+	return true;
+}
+
+// Полная трансляция программы repeats раз; время одной трансляции
+static double compileProgram(const string& text, int repeats, PerfCounters& perf)
+{
+	NullBuffer buffer;
+	ostream output(&buffer);
+	CompileOptions options;
+	options.output = &output;
+
+	perf.start();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int i = 0; i < repeats; ++i) {
+		istringstream input(text);
+		Parser parser("bench", input, options);
+		parser.parse();
+	}
+	double seconds = secondsSince(start);
+	perf.stop();
+	return seconds / repeats;
+}
+
+// Трансляция программы для виртуальной машины
+static bool loadProgram(const string& text, bool optimize, VirtualMachine& vm)
+{
+	ostringstream program;
+	CompileOptions options;
+	options.optimize = optimize;
+	options.output = &program;
+	istringstream input(text);
+	Parser parser("bench", input, options);
+	parser.parse();
+	if(parser.hasErrors()) {
+		return false;
+	}
+	istringstream code(program.str());
+	return vm.load(code);
+}
+
+// Выполнение программы repeats раз; время одного выполнения
+static double runProgram(VirtualMachine& vm, int repeats, PerfCounters& perf)
+{
+	NullBuffer buffer;
+	ostream output(&buffer);
+
+	perf.start();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int i = 0; i < repeats; ++i) {
+		istringstream input(VM_INPUT);
+		vm.run(input, output);
+	}
+	double seconds = secondsSince(start);
+	perf.stop();
+	return seconds / repeats;
+}
+
+// Замер действия, которое run(repeats) выполняет repeats раз и возвращает время
+// одного выполнения. Число повторов подбирается так, чтобы запуск длился не
+// меньше PROGRAM_RUN_SECONDS; счетчики делятся на число повторов.
+template<typename Run>
+static void measureRepeated(Benchmark& b, int warmup, int runs, PerfCounters& perf, Run run)
+{
+	int repeats = 1;
+	double once = run(1);
+	if(once < PROGRAM_RUN_SECONDS) {
+		repeats = static_cast<int>(PROGRAM_RUN_SECONDS / max(once, 1e-9)) + 1;
+	}
+
+	for(int r = -warmup; r < runs; ++r) {
+		double seconds = run(repeats);
+		if(r >= 0) {
+			b.record(seconds, perf);
+			for(vector<uint64_t>& values : b.counters) {
+				if(!values.empty()) {
+					values.back() /= repeats;
+				}
+			}
+		}
+	}
+}
+
+// Программа транслируется без ошибок (сообщения об ошибках не печатаются)
+static bool compilesCleanly(const string& text)
+{
+	NullBuffer buffer;
+	ostream output(&buffer);
+	CompileOptions options;
+	options.output = &output;
+	streambuf* errors = cerr.rdbuf(&buffer);
+	istringstream input(text);
+	Parser parser("bench", input, options);
+	parser.parse();
+	cerr.rdbuf(errors);
+	return !parser.hasErrors();
+}
+
+// Сравнение с базовым запуском; возвращает число регрессий
+static int compareWithBaseline(const vector<Benchmark>& results, const map<string, vector<double> >& baseline,
+		double threshold, double alpha)
+{
+	int regressions = 0;
+	cerr << "benchmark                          baseline       current    change   p-value" << endl;
+	for(const Benchmark& b : results) {
+		map<string, vector<double> >::const_iterator old = baseline.find(b.name);
+		if(old == baseline.end() || old->second.empty()) {
+			cerr << b.name << ": not in baseline" << endl;
+			continue;
+		}
+
+		double before = median(old->second);
+		double after = median(b.seconds);
+		double change = before > 0 ? after / before - 1 : 0;
+		double p = mannWhitneyP(old->second, b.seconds);
+		const char* verdict = "";
+		if(p < alpha && change > threshold) {
+			verdict = "  REGRESSION";
+			++regressions;
+		}
+		else if(p < alpha && change < -threshold) {
+			verdict = "  improved";
+		}
+
+		char line[256];
+		snprintf(line, sizeof(line), "%-30s %12.6f  %12.6f  %+7.1f%%  %8.4f%s",
+			b.name.c_str(), before, after, change * 100, p, verdict);
+		cerr << line << endl;
+	}
+	return regressions;
+}
+
+static void usage()
+{
+	cerr << "Usage: milan_bench [--runs=N] [--warmup=N] [--size=N] [--seed=N] [--only=KIND] [--out=FILE]" << endl;
+	cerr << "                   [--programs=DIR] [--baseline=FILE] [--threshold=PERCENT] [--alpha=P]" << endl;
+	cerr << "       milan_bench --generate=KIND [--size=N] [--seed=N]" << endl;
+	cerr << "Kinds: straight, nested, variables, comments, boolean (and programs for --only)" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	int runs = 10;
+	int warmup = 1;
+	size_t size = 100000;
+	uint64_t seed = 1;
+	string only;
+	string outName;
+	string generate;
+	string programs = MILAN_TEST_DIR;
+	string baselineName;
+	double threshold = 0.05;
+	double alpha = 0.05;
+
+	for(int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		if(strncmp(arg, "--runs=", 7) == 0) {
+			runs = max(atoi(arg + 7), 1);
+		}
+		else if(strncmp(arg, "--warmup=", 9) == 0) {
+			warmup = max(atoi(arg + 9), 0);
+		}
+		else if(strncmp(arg, "--size=", 7) == 0) {
+			size = strtoull(arg + 7, NULL, 10);
+		}
+		else if(strncmp(arg, "--seed=", 7) == 0) {
+			seed = strtoull(arg + 7, NULL, 10);
+		}
+		else if(strncmp(arg, "--only=", 7) == 0) {
+			only = arg + 7;
+		}
+		else if(strncmp(arg, "--out=", 6) == 0) {
+			outName = arg + 6;
+		}
+		else if(strncmp(arg, "--generate=", 11) == 0) {
+			generate = arg + 11;
+		}
+		else if(strncmp(arg, "--programs=", 11) == 0) {
+			programs = arg + 11;
+		}
+		else if(strncmp(arg, "--baseline=", 11) == 0) {
+			baselineName = arg + 11;
+		}
+		else if(strncmp(arg, "--threshold=", 12) == 0) {
+			threshold = atof(arg + 12) / 100;
+		}
+		else if(strncmp(arg, "--alpha=", 8) == 0) {
+			alpha = atof(arg + 8);
+		}
+		else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(!generate.empty()) {
+		string text = Generator(seed).program(generate, size);
+		if(text.empty()) {
+			usage();
+			return EXIT_FAILURE;
+		}
+		cout << text;
+		return EXIT_SUCCESS;
+	}
+
+	map<string, vector<double> > baseline;
+	if(!baselineName.empty() && !loadBaseline(baselineName, baseline)) {
+		cerr << "Cannot read baseline '" << baselineName << "'" << endl;
+		return EXIT_FAILURE;
+	}
+
+	PerfCounters perf;
+	if(!perf.available()) {
+		cerr << "Hardware performance counters are unavailable, measuring wall time only" << endl;
+	}
+
+	vector<Benchmark> results;
+	for(const char* kind : KINDS) {
+		if(!only.empty() && only != kind) {
+			continue;
+		}
+		string text = Generator(seed).program(kind, size);
+
+		Benchmark lex(string(kind) + "/lex", text.size(), "token");
+		Benchmark parse(string(kind) + "/parse", text.size(), "instruction");
+		Benchmark flush(string(kind) + "/flush", text.size(), "instruction");
+		for(int run = -warmup; run < runs; ++run) {
+			lexOnce(text, perf, lex, run >= 0);
+			if(!compileOnce(text, perf, parse, flush, run >= 0)) {
+				cerr << "Generated program '" << kind << "' does not compile" << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		results.push_back(lex);
+		results.push_back(parse);
+		results.push_back(flush);
+		cerr << kind << ": " << text.size() << " bytes, " << lex.items << " tokens, "
+		     << parse.items << " instructions" << endl;
+	}
+
+	// Программы из каталога в порядке имен
+	vector<filesystem::path> files;
+	error_code error;
+	if(!programs.empty() && (only.empty() || only == "programs")) {
+		for(filesystem::directory_iterator it(programs, error), end; !error && it != end; it.increment(error)) {
+			if(it->path().extension() == ".mil") {
+				files.push_back(it->path());
+			}
+		}
+		sort(files.begin(), files.end());
+	}
+	for(const filesystem::path& file : files) {
+		ifstream input(file);
+		string text((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+		if(!compilesCleanly(text)) {
+			cerr << "Skipping " << file.string() << ": compile errors" << endl;
+			continue;
+		}
+
+		string name = file.filename().string();
+		Benchmark program("program/" + name, text.size(), "compile");
+		program.items = 1;
+		measureRepeated(program, warmup, runs, perf, [&](int repeats) {
+			return compileProgram(text, repeats, perf);
+		});
+		results.push_back(program);
+
+		// Выполнение без оптимизации и с ней: items - выполненные инструкции машины
+		for(int optimize = 0; optimize < 2; ++optimize) {
+			VirtualMachine vm;
+			NullBuffer buffer;
+			ostream output(&buffer);
+			istringstream trial(VM_INPUT);
+			if(!loadProgram(text, optimize, vm) || !vm.run(trial, output)) {
+				cerr << "Skipping run of " << file.string() << endl;
+				break;
+			}
+			Benchmark execution("vm/" + name + (optimize ? "/optimized" : ""), text.size(), "instruction");
+			execution.items = vm.executed();
+			measureRepeated(execution, warmup, runs, perf, [&](int repeats) {
+				return runProgram(vm, repeats, perf);
+			});
+			results.push_back(execution);
+		}
+	}
+
+	if(results.empty()) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if(outName.empty()) {
+		printJson(cout, results, seed, size, runs, perf.available());
+	}
+	else {
+		ofstream out(outName.c_str());
+		if(!out) {
+			cerr << "Cannot write '" << outName << "'" << endl;
+			return EXIT_FAILURE;
+		}
+		printJson(out, results, seed, size, runs, perf.available());
+	}
+
+	if(!baselineName.empty() && compareWithBaseline(results, baseline, threshold, alpha) > 0) {
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,716 @@
+// Генератор таблично-управляемого лексического анализатора Милана.
+//
+// Использование: milan_lexgen <спецификация.lex> <выходной заголовок.h>
+//
+// По регулярным определениям и правилам из спецификации строится НКА
+// (конструкция Томпсона), затем он детерминируется построением подмножеств,
+// ДКА минимизируется разбиением на классы эквивалентных состояний, а столбцы
+// таблицы переходов склеиваются в классы эквивалентности байтов.
+// Результат записывается в заголовок, который подключает TableScanner.
+
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef bitset<256> CharSet;
+
+static string specName_;
+
+static void fail(int line, const string& message)
+{
+	cerr << specName_ << ":" << line << ": " << message << endl;
+	exit(EXIT_FAILURE);
+}
+
+// Состояние НКА: пустые переходы и не более одного перехода по множеству символов
+struct NfaState
+{
+	vector<int> epsilon;
+	CharSet chars;
+	int target;
+	int rule;  // номер правила, если состояние допускающее, иначе -1
+};
+
+// Фрагмент НКА с одним входом и одним выходом
+struct Fragment
+{
+	int start;
+	int end;
+};
+
+class Nfa
+{
+public:
+	int addState()
+	{
+		NfaState s;
+		s.target = -1;
+		s.rule = -1;
+		states.push_back(s);
+		return states.size() - 1;
+	}
+
+	void addEpsilon(int from, int to)
+	{
+		states[from].epsilon.push_back(to);
+	}
+
+	Fragment chars(const CharSet& set)
+	{
+		Fragment f = { addState(), addState() };
+		states[f.start].chars = set;
+		states[f.start].target = f.end;
+		return f;
+	}
+
+	Fragment empty()
+	{
+		Fragment f = { addState(), addState() };
+		addEpsilon(f.start, f.end);
+		return f;
+	}
+
+	Fragment concat(Fragment a, Fragment b)
+	{
+		addEpsilon(a.end, b.start);
+		Fragment f = { a.start, b.end };
+		return f;
+	}
+
+	Fragment alternate(Fragment a, Fragment b)
+	{
+		Fragment f = { addState(), addState() };
+		addEpsilon(f.start, a.start);
+		addEpsilon(f.start, b.start);
+		addEpsilon(a.end, f.end);
+		addEpsilon(b.end, f.end);
+		return f;
+	}
+
+	// min = 0, max = 1 - "?"; min = 0 - "*"; min = 1 - "+"
+	Fragment repeat(Fragment a, int min, bool unbounded)
+	{
+		Fragment f = { addState(), addState() };
+		addEpsilon(f.start, a.start);
+		addEpsilon(a.end, f.end);
+		if(min == 0) {
+			addEpsilon(f.start, f.end);
+		}
+		if(unbounded) {
+			addEpsilon(a.end, a.start);
+		}
+		return f;
+	}
+
+	vector<NfaState> states;
+};
+
+typedef map<string, string> Definitions;
+
+// Разбор регулярного выражения методом рекурсивного спуска:
+//     regex  -> concat { "|" concat }
+//     concat -> repeat { repeat }
+//     repeat -> atom { "*" | "+" | "?" }
+//     atom   -> "(" regex ")" | "..." | [класс] | {имя} | символ
+class RegexParser
+{
+public:
+	RegexParser(Nfa& nfa, const Definitions& definitions, const string& text, int line, int depth)
+		: nfa_(nfa), definitions_(definitions), text_(text), pos_(0), line_(line), depth_(depth)
+	{
+		if(depth_ > 32) {
+			fail(line_, "regular definitions are nested too deeply (cyclic?)");
+		}
+	}
+
+	Fragment parse()
+	{
+		Fragment f = alternation();
+		if(pos_ != text_.size()) {
+			fail(line_, "unexpected '" + string(1, text_[pos_]) + "' in pattern");
+		}
+		return f;
+	}
+
+private:
+	bool atEnd() const
+	{
+		return pos_ >= text_.size();
+	}
+
+	char peek() const
+	{
+		return text_[pos_];
+	}
+
+	Fragment alternation()
+	{
+		Fragment f = concatenation();
+		while(!atEnd() && peek() == '|') {
+			++pos_;
+			f = nfa_.alternate(f, concatenation());
+		}
+		return f;
+	}
+
+	Fragment concatenation()
+	{
+		if(atEnd() || peek() == '|' || peek() == ')') {
+			return nfa_.empty();
+		}
+
+		Fragment f = repetition();
+		while(!atEnd() && peek() != '|' && peek() != ')') {
+			f = nfa_.concat(f, repetition());
+		}
+		return f;
+	}
+
+	Fragment repetition()
+	{
+		Fragment f = atom();
+		while(!atEnd()) {
+			if(peek() == '*') {
+				f = nfa_.repeat(f, 0, true);
+			}
+			else if(peek() == '+') {
+				f = nfa_.repeat(f, 1, true);
+			}
+			else if(peek() == '?') {
+				f = nfa_.repeat(f, 0, false);
+			}
+			else {
+				break;
+			}
+			++pos_;
+		}
+		return f;
+	}
+
+	Fragment atom()
+	{
+		char c = peek();
+		++pos_;
+		switch(c) {
+			case '(': {
+				Fragment f = alternation();
+				if(atEnd() || peek() != ')') {
+					fail(line_, "')' expected in pattern");
+				}
+				++pos_;
+				return f;
+			}
+
+			case '"': {
+				Fragment f = nfa_.empty();
+				while(!atEnd() && peek() != '"') {
+					CharSet set;
+					set.set(character());
+					f = nfa_.concat(f, nfa_.chars(set));
+				}
+				if(atEnd()) {
+					fail(line_, "unterminated string in pattern");
+				}
+				++pos_;
+				return f;
+			}
+
+			case '[':
+				return nfa_.chars(charClass());
+
+			case '{': {
+				size_t close = text_.find('}', pos_);
+				if(close == string::npos) {
+					fail(line_, "'}' expected in pattern");
+				}
+				string name = text_.substr(pos_, close - pos_);
+				pos_ = close + 1;
+
+				Definitions::const_iterator it = definitions_.find(name);
+				if(it == definitions_.end()) {
+					fail(line_, "undefined regular definition '" + name + "'");
+				}
+				RegexParser sub(nfa_, definitions_, it->second, line_, depth_ + 1);
+				return sub.parse();
+			}
+
+			case '*':
+			case '+':
+			case '?':
+			case ')':
+			case '|':
+				fail(line_, "unexpected '" + string(1, c) + "' in pattern");
+				break;
+
+			default:
+				break;
+		}
+
+		--pos_;
+		CharSet set;
+		set.set(character());
+		return nfa_.chars(set);
+	}
+
+	CharSet charClass()
+	{
+		CharSet set;
+		bool negate = false;
+		if(!atEnd() && peek() == '^') {
+			negate = true;
+			++pos_;
+		}
+
+		while(!atEnd() && peek() != ']') {
+			unsigned char low = character();
+			unsigned char high = low;
+			if(pos_ + 1 < text_.size() && peek() == '-' && text_[pos_ + 1] != ']') {
+				++pos_;
+				high = character();
+			}
+			if(high < low) {
+				fail(line_, "invalid range in character class");
+			}
+			for(int c = low; c <= high; ++c) {
+				set.set(c);
+			}
+		}
+		if(atEnd()) {
+			fail(line_, "']' expected in pattern");
+		}
+		++pos_;
+
+		return negate ? ~set : set;
+	}
+
+	// Один символ с учетом экранирования
+	unsigned char character()
+	{
+		unsigned char c = text_[pos_++];
+		if(c != '\\') {
+			return c;
+		}
+		if(atEnd()) {
+			fail(line_, "dangling '\\' in pattern");
+		}
+
+		c = text_[pos_++];
+		switch(c) {
+			case 'n': return '\n';
+			case 't': return '\t';
+			case 'v': return '\v';
+			case 'f': return '\f';
+			case 'r': return '\r';
+			case 'x': {
+				if(pos_ + 2 > text_.size()) {
+					fail(line_, "two hex digits expected after '\\x'");
+				}
+				string hex = text_.substr(pos_, 2);
+				pos_ += 2;
+				return static_cast<unsigned char>(strtol(hex.c_str(), 0, 16));
+			}
+			default:
+				return c;
+		}
+	}
+
+	Nfa& nfa_;
+	const Definitions& definitions_;
+	const string text_;
+	size_t pos_;
+	int line_;
+	int depth_;
+};
+
+// Действие правила спецификации
+struct Rule
+{
+	string token;  // имя лексемы без T_, "SKIP" или "EOF"
+	string value;  // значение Cmp/Arithmetic или пустая строка
+	int line;
+};
+
+// Выделение шаблона в начале строки: шаблон заканчивается на первом пробеле
+// вне строки в кавычках и вне класса символов
+static size_t patternLength(const string& line)
+{
+	bool quoted = false;
+	bool bracket = false;
+	for(size_t i = 0; i < line.size(); ++i) {
+		char c = line[i];
+		if(c == '\\') {
+			++i;
+		}
+		else if(quoted) {
+			quoted = c != '"';
+		}
+		else if(bracket) {
+			bracket = c != ']';
+		}
+		else if(c == '"') {
+			quoted = true;
+		}
+		else if(c == '[') {
+			bracket = true;
+		}
+		else if(c == ' ' || c == '\t') {
+			return i;
+		}
+	}
+	return line.size();
+}
+
+// ДКА: переходы по классам байтов, состояние 0 - тупиковое
+struct Dfa
+{
+	vector<int> byteClass;        // класс каждого байта
+	int classes;
+	vector<vector<int> > next;    // next[состояние][класс]
+	vector<int> accept;           // номер правила + 1 или 0
+	int start;
+};
+
+static void closure(const Nfa& nfa, vector<int>& set)
+{
+	vector<bool> seen(nfa.states.size(), false);
+	vector<int> work(set);
+	for(int s : set) {
+		seen[s] = true;
+	}
+	while(!work.empty()) {
+		int s = work.back();
+		work.pop_back();
+		for(int t : nfa.states[s].epsilon) {
+			if(!seen[t]) {
+				seen[t] = true;
+				set.push_back(t);
+				work.push_back(t);
+			}
+		}
+	}
+	sort(set.begin(), set.end());
+}
+
+// Разбиение байтов на классы: байты эквивалентны, если они входят
+// в одни и те же множества переходов НКА
+static int nfaByteClasses(const Nfa& nfa, vector<int>& byteClass)
+{
+	vector<CharSet> sets;
+	for(const NfaState& s : nfa.states) {
+		if(s.target >= 0 && find(sets.begin(), sets.end(), s.chars) == sets.end()) {
+			sets.push_back(s.chars);
+		}
+	}
+
+	map<vector<bool>, int> signatures;
+	byteClass.assign(256, 0);
+	for(int b = 0; b < 256; ++b) {
+		vector<bool> signature;
+		for(const CharSet& set : sets) {
+			signature.push_back(set.test(b));
+		}
+		map<vector<bool>, int>::iterator it = signatures.find(signature);
+		if(it == signatures.end()) {
+			it = signatures.insert(make_pair(signature, (int)signatures.size())).first;
+		}
+		byteClass[b] = it->second;
+	}
+	return signatures.size();
+}
+
+static Dfa determinize(const Nfa& nfa, int nfaStart)
+{
+	Dfa dfa;
+	dfa.classes = nfaByteClasses(nfa, dfa.byteClass);
+
+	vector<int> representative(dfa.classes, -1);
+	for(int b = 255; b >= 0; --b) {
+		representative[dfa.byteClass[b]] = b;
+	}
+
+	// Состояние 0 - тупиковое
+	map<vector<int>, int> index;
+	vector<vector<int> > sets(1);
+	dfa.next.push_back(vector<int>(dfa.classes, 0));
+	dfa.accept.push_back(0);
+
+	vector<int> start(1, nfaStart);
+	closure(nfa, start);
+	index[start] = 1;
+	sets.push_back(start);
+	dfa.next.push_back(vector<int>(dfa.classes, 0));
+	dfa.accept.push_back(0);
+	dfa.start = 1;
+
+	for(size_t d = 1; d < sets.size(); ++d) {
+		int rule = -1;
+		for(int s : sets[d]) {
+			int r = nfa.states[s].rule;
+			if(r >= 0 && (rule < 0 || r < rule)) {
+				rule = r;
+			}
+		}
+		dfa.accept[d] = rule + 1;
+
+		for(int c = 0; c < dfa.classes; ++c) {
+			vector<int> target;
+			for(int s : sets[d]) {
+				const NfaState& state = nfa.states[s];
+				if(state.target >= 0 && state.chars.test(representative[c])) {
+					target.push_back(state.target);
+				}
+			}
+			if(target.empty()) {
+				continue;
+			}
+			closure(nfa, target);
+
+			map<vector<int>, int>::iterator it = index.find(target);
+			if(it == index.end()) {
+				it = index.insert(make_pair(target, (int)sets.size())).first;
+				sets.push_back(target);
+				dfa.next.push_back(vector<int>(dfa.classes, 0));
+				dfa.accept.push_back(0);
+			}
+			dfa.next[d][c] = it->second;
+		}
+	}
+	return dfa;
+}
+
+// Минимизация: итеративное измельчение разбиения состояний, начиная с разбиения
+// по допускаемому правилу. Тупиковое состояние остается с номером 0,
+// начальное получает номер 1.
+static Dfa minimize(const Dfa& dfa)
+{
+	int count = dfa.next.size();
+	vector<int> block(dfa.accept);
+	int blocks = 0;
+
+	for(;;) {
+		map<vector<int>, int> signatures;
+		vector<int> refined(count);
+		for(int s = 0; s < count; ++s) {
+			vector<int> signature(1, block[s]);
+			for(int c = 0; c < dfa.classes; ++c) {
+				signature.push_back(block[dfa.next[s][c]]);
+			}
+			map<vector<int>, int>::iterator it = signatures.find(signature);
+			if(it == signatures.end()) {
+				it = signatures.insert(make_pair(signature, (int)signatures.size())).first;
+			}
+			refined[s] = it->second;
+		}
+		block.swap(refined);
+		if((int)signatures.size() == blocks) {
+			break;
+		}
+		blocks = signatures.size();
+	}
+
+	vector<int> number(blocks, -1);
+	number[block[0]] = 0;
+	number[block[dfa.start]] = 1;
+	int states = 2;
+	for(int s = 0; s < count; ++s) {
+		if(number[block[s]] < 0) {
+			number[block[s]] = states++;
+		}
+	}
+
+	Dfa result;
+	result.byteClass = dfa.byteClass;
+	result.classes = dfa.classes;
+	result.start = 1;
+	result.next.assign(states, vector<int>(dfa.classes, 0));
+	result.accept.assign(states, 0);
+	for(int s = 0; s < count; ++s) {
+		int m = number[block[s]];
+		result.accept[m] = dfa.accept[s];
+		for(int c = 0; c < dfa.classes; ++c) {
+			result.next[m][c] = number[block[dfa.next[s][c]]];
+		}
+	}
+	return result;
+}
+
+// Склеивание классов байтов с одинаковыми столбцами таблицы переходов
+static Dfa compressClasses(const Dfa& dfa)
+{
+	map<vector<int>, int> columns;
+	vector<int> remap(dfa.classes);
+	for(int c = 0; c < dfa.classes; ++c) {
+		vector<int> column;
+		for(size_t s = 0; s < dfa.next.size(); ++s) {
+			column.push_back(dfa.next[s][c]);
+		}
+		map<vector<int>, int>::iterator it = columns.find(column);
+		if(it == columns.end()) {
+			it = columns.insert(make_pair(column, (int)columns.size())).first;
+		}
+		remap[c] = it->second;
+	}
+
+	Dfa result(dfa);
+	result.classes = columns.size();
+	for(int b = 0; b < 256; ++b) {
+		result.byteClass[b] = remap[dfa.byteClass[b]];
+	}
+	for(size_t s = 0; s < dfa.next.size(); ++s) {
+		result.next[s].assign(result.classes, 0);
+		for(int c = 0; c < dfa.classes; ++c) {
+			result.next[s][remap[c]] = dfa.next[s][c];
+		}
+	}
+	return result;
+}
+
+static void writeHeader(ostream& out, const Dfa& dfa, const vector<Rule>& rules)
+{
+	const char* cell = dfa.next.size() <= 256 ? "unsigned char" : "unsigned short";
+
+	out << "// Сгенерировано milan_lexgen из " << specName_ << ". Не редактировать.\n"
+		<< "//\n"
+		<< "// ДКА лексического анализатора Милана: " << dfa.next.size() << " состояний, "
+		<< dfa.classes << " классов байтов, " << rules.size() << " правил.\n"
+		<< "// Состояние 0 - тупиковое, 1 - начальное.\n\n"
+		<< "#ifndef MILAN_DFA_H\n"
+		<< "#define MILAN_DFA_H\n\n"
+		<< "// Действие правила: лексема и ее значение (Cmp или Arithmetic),\n"
+		<< "// skip - лексема пропускается (пробелы, комментарии)\n"
+		<< "struct MilanDfaRule\n{\n\tToken token;\n\tint value;\n\tbool skip;\n};\n\n"
+		<< "static const int MILAN_DFA_START = " << dfa.start << ";\n"
+		<< "static const int MILAN_DFA_STATES = " << dfa.next.size() << ";\n"
+		<< "static const int MILAN_DFA_CLASSES = " << dfa.classes << ";\n\n";
+
+	out << "// Класс эквивалентности каждого байта\n"
+		<< "static const unsigned char milanDfaClass[256] = {";
+	for(int b = 0; b < 256; ++b) {
+		out << (b % 16 == 0 ? "\n\t" : " ") << dfa.byteClass[b] << ",";
+	}
+	out << "\n};\n\n";
+
+	out << "// Переходы: milanDfaNext[состояние][класс]\n"
+		<< "static const " << cell << " milanDfaNext[" << dfa.next.size() << "][" << dfa.classes << "] = {\n";
+	for(size_t s = 0; s < dfa.next.size(); ++s) {
+		out << "\t{";
+		for(int c = 0; c < dfa.classes; ++c) {
+			out << (c ? ", " : "") << dfa.next[s][c];
+		}
+		out << "},\n";
+	}
+	out << "};\n\n";
+
+	out << "// Правило, допускаемое в состоянии (номер в milanDfaRules), 0 - состояние не допускающее\n"
+		<< "static const unsigned char milanDfaAccept[" << dfa.accept.size() << "] = {";
+	for(size_t s = 0; s < dfa.accept.size(); ++s) {
+		out << (s % 16 == 0 ? "\n\t" : " ") << dfa.accept[s] << ",";
+	}
+	out << "\n};\n\n";
+
+	out << "static const MilanDfaRule milanDfaRules[" << rules.size() + 1 << "] = {\n"
+		<< "\t{ T_ILLEGAL, 0, false },\n";
+	for(const Rule& rule : rules) {
+		bool skip = rule.token == "SKIP";
+		out << "\t{ T_" << (skip ? "EOF" : rule.token) << ", "
+			<< (rule.value.empty() ? "0" : rule.value) << ", "
+			<< (skip ? "true" : "false") << " },"
+			<< "\t// " << specName_ << ":" << rule.line << "\n";
+	}
+	out << "};\n\n"
+		<< "#endif\n";
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3) {
+		cerr << "Usage: milan_lexgen spec.lex output.h" << endl;
+		return EXIT_FAILURE;
+	}
+
+	specName_ = argv[1];
+	size_t slash = specName_.find_last_of("/\\");
+	if(slash != string::npos) {
+		specName_ = specName_.substr(slash + 1);
+	}
+
+	ifstream spec(argv[1]);
+	if(!spec) {
+		cerr << "File '" << argv[1] << "' not found" << endl;
+		return EXIT_FAILURE;
+	}
+
+	Nfa nfa;
+	int nfaStart = nfa.addState();
+	Definitions definitions;
+	vector<Rule> rules;
+	bool inRules = false;
+
+	string line;
+	for(int lineNumber = 1; getline(spec, line); ++lineNumber) {
+		if(!line.empty() && line[line.size() - 1] == '\r') {
+			line.erase(line.size() - 1);
+		}
+		if(line.empty() || line[0] == '#' || line.find_first_not_of(" \t") == string::npos) {
+			continue;
+		}
+		if(line == "%%") {
+			inRules = true;
+			continue;
+		}
+
+		if(!inRules) {
+			istringstream fields(line);
+			string name, pattern;
+			fields >> name >> ws;
+			getline(fields, pattern);
+			if(pattern.empty()) {
+				fail(lineNumber, "pattern expected after '" + name + "'");
+			}
+			definitions[name] = pattern.substr(0, patternLength(pattern));
+			continue;
+		}
+
+		size_t length = patternLength(line);
+		istringstream fields(line.substr(length));
+		Rule rule;
+		rule.line = lineNumber;
+		fields >> rule.token >> rule.value;
+		if(rule.token.empty()) {
+			fail(lineNumber, "action expected after pattern");
+		}
+
+		RegexParser parser(nfa, definitions, line.substr(0, length), lineNumber, 0);
+		Fragment f = parser.parse();
+		nfa.addEpsilon(nfaStart, f.start);
+		nfa.states[f.end].rule = rules.size();
+		rules.push_back(rule);
+	}
+
+	if(rules.empty()) {
+		fail(0, "no rules");
+	}
+
+	Dfa dfa = compressClasses(minimize(determinize(nfa, nfaStart)));
+	if(dfa.next.size() > 65536 || rules.size() > 255) {
+		fail(0, "automaton is too large for the table format");
+	}
+
+	ofstream out(argv[2]);
+	if(!out) {
+		cerr << "Cannot write '" << argv[2] << "'" << endl;
+		return EXIT_FAILURE;
+	}
+	writeHeader(out, dfa, rules);
+	return EXIT_SUCCESS;
+}
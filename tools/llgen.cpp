@@ -0,0 +1,474 @@
+// Генератор таблицы LL(1)-разбора для языка Милан.
+//
+// Использование: milan_llgen <грамматика.ll> <выходной заголовок.h>
+//
+// По грамматике с семантическими действиями вычисляются множества FIRST и FOLLOW,
+// строится таблица разбора и проверяется, что грамматика относится к классу LL(1).
+// Результат записывается в заголовок, который подключает Parser::parseLL1().
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static string grammarName_;
+
+static void fail(int line, const string& message)
+{
+	cerr << grammarName_ << ":" << line << ": " << message << endl;
+	exit(EXIT_FAILURE);
+}
+
+// Вид символа грамматики
+enum SymbolKind
+{
+	TERMINAL,
+	NONTERMINAL,
+	ACTION
+};
+
+struct Symbol
+{
+	SymbolKind kind;
+	int index;
+};
+
+struct Production
+{
+	int lhs;
+	vector<Symbol> rhs;
+	int line;
+	bool isDefault;  // альтернатива отмечена словом default
+};
+
+class Grammar
+{
+public:
+	int terminal(const string& name)
+	{
+		return intern(terminals, terminalIndex, name);
+	}
+
+	int nonterminal(const string& name, int line)
+	{
+		int index = intern(nonterminals, nonterminalIndex, name);
+		if(index == (int)firstUse.size()) {
+			firstUse.push_back(line);
+			errors.push_back("");
+		}
+		return index;
+	}
+
+	int action(const string& name)
+	{
+		return intern(actions, actionIndex, name);
+	}
+
+	vector<string> terminals;
+	vector<string> nonterminals;
+	vector<string> actions;
+	vector<int> firstUse;
+	vector<string> errors;           // сообщение об ошибке для нетерминала
+	vector<Production> productions;
+
+private:
+	static int intern(vector<string>& names, map<string, int>& index, const string& name)
+	{
+		map<string, int>::iterator it = index.find(name);
+		if(it != index.end()) {
+			return it->second;
+		}
+		index[name] = names.size();
+		names.push_back(name);
+		return names.size() - 1;
+	}
+
+	map<string, int> terminalIndex;
+	map<string, int> nonterminalIndex;
+	map<string, int> actionIndex;
+};
+
+// Разбор текста грамматики. Лексемы: имена, @действия, "->", "|", ";",
+// строки вида "имя ! сообщение"; "#" начинает комментарий до конца строки.
+static void readGrammar(istream& in, Grammar& grammar)
+{
+	vector<bool> defined;
+	string line;
+	int lhs = -1;
+	Production current;
+
+	for(int lineNumber = 1; getline(in, line); ++lineNumber) {
+		size_t hash = line.find('#');
+		if(hash != string::npos) {
+			line.erase(hash);
+		}
+
+		istringstream words(line);
+		string word;
+		while(words >> word) {
+			if(lhs < 0) {
+				int nt = grammar.nonterminal(word, lineNumber);
+				string arrow;
+				words >> arrow;
+				if(arrow == "!") {
+					string message;
+					getline(words >> ws, message);
+					grammar.errors[nt] = message;
+					break;
+				}
+				if(arrow != "->") {
+					fail(lineNumber, "'->' or '!' expected after '" + word + "'");
+				}
+				if(nt < (int)defined.size() && defined[nt]) {
+					fail(lineNumber, "rules for '" + word + "' are already defined");
+				}
+				defined.resize(grammar.nonterminals.size(), false);
+				defined[nt] = true;
+
+				lhs = nt;
+				current.lhs = lhs;
+				current.rhs.clear();
+				current.line = lineNumber;
+				current.isDefault = false;
+			}
+			else if(word == "|" || word == ";") {
+				grammar.productions.push_back(current);
+				current.rhs.clear();
+				current.line = lineNumber;
+				current.isDefault = false;
+				if(word == ";") {
+					lhs = -1;
+				}
+			}
+			else if(word == "default" && current.rhs.empty()) {
+				current.isDefault = true;
+			}
+			else {
+				Symbol symbol;
+				if(word[0] == '@') {
+					symbol.kind = ACTION;
+					symbol.index = grammar.action(word.substr(1));
+				}
+				else if(isupper(static_cast<unsigned char>(word[0]))) {
+					symbol.kind = TERMINAL;
+					symbol.index = grammar.terminal(word);
+				}
+				else {
+					symbol.kind = NONTERMINAL;
+					symbol.index = grammar.nonterminal(word, lineNumber);
+				}
+				current.rhs.push_back(symbol);
+			}
+		}
+	}
+
+	if(lhs >= 0) {
+		fail(current.line, "';' expected at the end of the rule");
+	}
+	defined.resize(grammar.nonterminals.size(), false);
+	for(size_t nt = 0; nt < grammar.nonterminals.size(); ++nt) {
+		if(!defined[nt]) {
+			fail(grammar.firstUse[nt], "nonterminal '" + grammar.nonterminals[nt] + "' has no rules");
+		}
+	}
+	if(grammar.productions.empty()) {
+		fail(0, "empty grammar");
+	}
+}
+
+// Множества FIRST и FOLLOW. Конец текста - терминал с номером terminals.size().
+struct Sets
+{
+	vector<bool> nullable;
+	vector<set<int> > first;
+	vector<set<int> > follow;
+};
+
+// FIRST для последовательности символов, начиная с позиции from.
+// Возвращает true, если последовательность может порождать пустую цепочку.
+static bool sequenceFirst(const Sets& sets, const vector<Symbol>& rhs, size_t from, set<int>& result)
+{
+	for(size_t i = from; i < rhs.size(); ++i) {
+		const Symbol& s = rhs[i];
+		if(s.kind == TERMINAL) {
+			result.insert(s.index);
+			return false;
+		}
+		if(s.kind == NONTERMINAL) {
+			result.insert(sets.first[s.index].begin(), sets.first[s.index].end());
+			if(!sets.nullable[s.index]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static Sets computeSets(const Grammar& grammar)
+{
+	size_t count = grammar.nonterminals.size();
+	Sets sets;
+	sets.nullable.assign(count, false);
+	sets.first.resize(count);
+	sets.follow.resize(count);
+	sets.follow[grammar.productions[0].lhs].insert(grammar.terminals.size());
+
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(const Production& p : grammar.productions) {
+			set<int> first;
+			bool nullable = sequenceFirst(sets, p.rhs, 0, first);
+			size_t before = sets.first[p.lhs].size();
+			sets.first[p.lhs].insert(first.begin(), first.end());
+			if(sets.first[p.lhs].size() != before || (nullable && !sets.nullable[p.lhs])) {
+				changed = true;
+			}
+			if(nullable) {
+				sets.nullable[p.lhs] = true;
+			}
+		}
+	}
+
+	changed = true;
+	while(changed) {
+		changed = false;
+		for(const Production& p : grammar.productions) {
+			for(size_t i = 0; i < p.rhs.size(); ++i) {
+				if(p.rhs[i].kind != NONTERMINAL) {
+					continue;
+				}
+				set<int>& follow = sets.follow[p.rhs[i].index];
+				size_t before = follow.size();
+				set<int> rest;
+				if(sequenceFirst(sets, p.rhs, i + 1, rest)) {
+					rest.insert(sets.follow[p.lhs].begin(), sets.follow[p.lhs].end());
+				}
+				follow.insert(rest.begin(), rest.end());
+				if(follow.size() != before) {
+					changed = true;
+				}
+			}
+		}
+	}
+	return sets;
+}
+
+static bool isEpsilon(const Production& p)
+{
+	for(const Symbol& s : p.rhs) {
+		if(s.kind != ACTION) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static string upper(const string& name)
+{
+	string result(name);
+	for(char& c : result) {
+		c = toupper(static_cast<unsigned char>(c));
+	}
+	return result;
+}
+
+static string symbolName(const Grammar& grammar, const Symbol& s)
+{
+	switch(s.kind) {
+		case TERMINAL:
+			return "T_" + grammar.terminals[s.index];
+		case NONTERMINAL:
+			return "NT_" + upper(grammar.nonterminals[s.index]);
+		default:
+			return "LA_" + upper(grammar.actions[s.index]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3) {
+		cerr << "Usage: milan_llgen grammar.ll output.h" << endl;
+		return EXIT_FAILURE;
+	}
+
+	grammarName_ = argv[1];
+	size_t slash = grammarName_.find_last_of("/\\");
+	if(slash != string::npos) {
+		grammarName_ = grammarName_.substr(slash + 1);
+	}
+
+	ifstream in(argv[1]);
+	if(!in) {
+		cerr << "File '" << argv[1] << "' not found" << endl;
+		return EXIT_FAILURE;
+	}
+
+	Grammar grammar;
+	readGrammar(in, grammar);
+	Sets sets = computeSets(grammar);
+
+	// Столбцы таблицы: терминалы грамматики, конец текста (EOF) и все прочие лексемы
+	size_t eofColumn = grammar.terminals.size();
+	size_t columns = eofColumn + 2;
+	size_t rows = grammar.nonterminals.size();
+
+	vector<vector<int> > table(rows, vector<int>(columns, 0));
+	for(size_t i = 0; i < grammar.productions.size(); ++i) {
+		const Production& p = grammar.productions[i];
+		set<int> select;
+		if(sequenceFirst(sets, p.rhs, 0, select)) {
+			select.insert(sets.follow[p.lhs].begin(), sets.follow[p.lhs].end());
+		}
+		for(int t : select) {
+			if(table[p.lhs][t] != 0) {
+				// Конфликт непустого правила с эпсилон-правилом решается в пользу
+				// непустого (самое длинное совпадение, как для "висячего" else)
+				const Production& other = grammar.productions[table[p.lhs][t] - 1];
+				if(isEpsilon(p)) {
+					continue;
+				}
+				if(isEpsilon(other)) {
+					table[p.lhs][t] = i + 1;
+					continue;
+				}
+
+				ostringstream message;
+				message << "LL(1) conflict for '" << grammar.nonterminals[p.lhs] << "' on "
+						<< (t == (int)eofColumn ? string("EOF") : grammar.terminals[t])
+						<< " with the rule at line " << other.line;
+				fail(p.line, message.str());
+			}
+			table[p.lhs][t] = i + 1;
+		}
+	}
+
+	// Правила по умолчанию для пустых клеток: отмеченное словом default,
+	// иначе эпсилон-правило, иначе (если для нетерминала нет сообщения об ошибке)
+	// последняя альтернатива
+	for(size_t nt = 0; nt < rows; ++nt) {
+		int fallback = 0;
+		int epsilon = 0;
+		int marked = 0;
+		for(size_t i = 0; i < grammar.productions.size(); ++i) {
+			const Production& p = grammar.productions[i];
+			if(p.lhs != (int)nt) {
+				continue;
+			}
+			if(p.isDefault) {
+				marked = i + 1;
+			}
+			if(isEpsilon(p) && epsilon == 0) {
+				epsilon = i + 1;
+			}
+			if(grammar.errors[nt].empty()) {
+				fallback = i + 1;
+			}
+		}
+		if(marked != 0) {
+			fallback = marked;
+		}
+		else if(epsilon != 0) {
+			fallback = epsilon;
+		}
+		for(size_t t = 0; t < columns; ++t) {
+			if(table[nt][t] == 0) {
+				table[nt][t] = fallback;
+			}
+		}
+	}
+
+	if(grammar.productions.size() > 255) {
+		fail(0, "too many rules for the table format");
+	}
+
+	ofstream out(argv[2]);
+	if(!out) {
+		cerr << "Cannot write '" << argv[2] << "'" << endl;
+		return EXIT_FAILURE;
+	}
+
+	out << "// Сгенерировано milan_llgen из " << grammarName_ << ". Не редактировать.\n"
+		<< "//\n"
+		<< "// Таблица LL(1)-разбора языка Милан: " << rows << " нетерминалов, "
+		<< grammar.productions.size() << " правил, " << grammar.actions.size() << " семантических действий.\n\n"
+		<< "#ifndef MILAN_LL1_H\n"
+		<< "#define MILAN_LL1_H\n\n"
+		<< "// Символы в стеке разбора: лексемы (Token), нетерминалы и семантические действия\n"
+		<< "enum { MILAN_LL_NONTERMINAL = 1000, MILAN_LL_ACTION = 2000 };\n\n"
+		<< "enum MilanLLNonterminal\n{\n";
+	for(size_t nt = 0; nt < rows; ++nt) {
+		out << "\tNT_" << upper(grammar.nonterminals[nt]) << (nt == 0 ? " = MILAN_LL_NONTERMINAL" : "") << ",\n";
+	}
+	out << "};\n\n"
+		<< "enum MilanLLAction\n{\n";
+	for(size_t a = 0; a < grammar.actions.size(); ++a) {
+		out << "\tLA_" << upper(grammar.actions[a]) << (a == 0 ? " = MILAN_LL_ACTION" : "") << ",\n";
+	}
+	out << "};\n\n";
+
+	out << "static const int MILAN_LL_START = NT_" << upper(grammar.nonterminals[grammar.productions[0].lhs]) << ";\n"
+		<< "static const int MILAN_LL_COLUMNS = " << columns << ";\n\n"
+		<< "// Лексемы, которым соответствуют столбцы таблицы. Последний столбец - все прочие лексемы.\n"
+		<< "static const Token milanLLTerminals[" << columns - 1 << "] = {\n";
+	for(size_t t = 0; t < grammar.terminals.size(); ++t) {
+		out << "\tT_" << grammar.terminals[t] << ",\n";
+	}
+	out << "\tT_EOF,\n};\n\n";
+
+	out << "// Правые части правил в обратном порядке (в таком порядке символы кладутся в стек)\n"
+		<< "static const int milanLLRhs[] = {\n";
+	vector<int> offsets;
+	int offset = 0;
+	for(const Production& p : grammar.productions) {
+		offsets.push_back(offset);
+		out << "\t";
+		for(size_t i = p.rhs.size(); i > 0; --i) {
+			out << symbolName(grammar, p.rhs[i - 1]) << ", ";
+		}
+		out << "// " << grammarName_ << ":" << p.line << "\n";
+		offset += p.rhs.size();
+	}
+	out << "\t0\n};\n\n";
+
+	out << "// Правило: смещение правой части в milanLLRhs и ее длина. Правило 0 - ошибка.\n"
+		<< "struct MilanLLProduction\n{\n\tshort offset;\n\tshort length;\n};\n\n"
+		<< "static const MilanLLProduction milanLLProductions[" << grammar.productions.size() + 1 << "] = {\n"
+		<< "\t{ 0, 0 },\n";
+	for(size_t i = 0; i < grammar.productions.size(); ++i) {
+		out << "\t{ " << offsets[i] << ", " << grammar.productions[i].rhs.size() << " },\n";
+	}
+	out << "};\n\n";
+
+	out << "// milanLLTable[нетерминал][столбец] - номер правила\n"
+		<< "static const unsigned char milanLLTable[" << rows << "][" << columns << "] = {\n";
+	for(size_t nt = 0; nt < rows; ++nt) {
+		out << "\t{";
+		for(size_t t = 0; t < columns; ++t) {
+			out << (t ? ", " : "") << table[nt][t];
+		}
+		out << "},\t// " << grammar.nonterminals[nt] << "\n";
+	}
+	out << "};\n\n";
+
+	out << "// Сообщение об ошибке, если для нетерминала нет подходящего правила\n"
+		<< "static const char* const milanLLErrors[" << rows << "] = {\n";
+	for(size_t nt = 0; nt < rows; ++nt) {
+		if(grammar.errors[nt].empty()) {
+			out << "\t0,\n";
+		}
+		else {
+			out << "\t\"" << grammar.errors[nt] << "\",\n";
+		}
+	}
+	out << "};\n\n"
+		<< "#endif\n";
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+#ifndef CMILAN_PERFCOUNTERS_H
+#define CMILAN_PERFCOUNTERS_H
+
+// Аппаратные счетчики производительности процессора для milan_bench.
+//
+// В Linux счетчики открываются через perf_event_open, каждый отдельно и только
+// для пользовательского кода этого потока, поэтому недоступный счетчик (нет PMU
+// в виртуальной машине, запрет в контейнере) просто отсутствует в результатах.
+// Если не открылся ни один, available() возвращает false и замеры идут только
+// по времени. Значения масштабируются на долю времени, в течение которой
+// счетчик действительно работал (при мультиплексировании).
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfCounters
+{
+public:
+	enum Event
+	{
+		CYCLES,
+		INSTRUCTIONS,
+		BRANCH_MISSES,
+		L1D_MISSES,
+		LLC_MISSES,
+		EVENT_COUNT
+	};
+
+	PerfCounters()
+	{
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			fds_[e] = -1;
+			values_[e] = 0;
+		}
+#ifdef __linux__
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			fds_[e] = open(static_cast<Event>(e));
+		}
+#endif
+	}
+
+	~PerfCounters()
+	{
+#ifdef __linux__
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			if(fds_[e] >= 0) {
+				close(fds_[e]);
+			}
+		}
+#endif
+	}
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// Открыт хотя бы один счетчик
+	bool available() const
+	{
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			if(fds_[e] >= 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Открыт счетчик event
+	bool has(Event event) const
+	{
+		return fds_[event] >= 0;
+	}
+
+	// Сброс и запуск всех счетчиков
+	void start()
+	{
+#ifdef __linux__
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			if(fds_[e] >= 0) {
+				ioctl(fds_[e], PERF_EVENT_IOC_RESET, 0);
+				ioctl(fds_[e], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	// Остановка счетчиков и чтение значений
+	void stop()
+	{
+#ifdef __linux__
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			if(fds_[e] >= 0) {
+				ioctl(fds_[e], PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+		for(int e = 0; e < EVENT_COUNT; ++e) {
+			values_[e] = 0;
+			// Значение, время включения и время работы (PERF_FORMAT_TOTAL_TIME_*)
+			uint64_t data[3];
+			if(fds_[e] >= 0 && read(fds_[e], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data))) {
+				values_[e] = data[2] > 0 && data[2] < data[1]
+					? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2])
+					: data[0];
+			}
+		}
+#endif
+	}
+
+	// Значение счетчика за последний интервал start() - stop()
+	uint64_t value(Event event) const
+	{
+		return values_[event];
+	}
+
+	// Имя счетчика для отчета
+	static const char* name(Event event)
+	{
+		static const char* const names[EVENT_COUNT] = {
+			"cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+		};
+		return names[event];
+	}
+
+private:
+#ifdef __linux__
+	static int open(Event event)
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		switch(event) {
+			case CYCLES:
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = PERF_COUNT_HW_CPU_CYCLES;
+				break;
+			case INSTRUCTIONS:
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+				break;
+			case BRANCH_MISSES:
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+				break;
+			case L1D_MISSES:
+				attr.type = PERF_TYPE_HW_CACHE;
+				attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+					(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+				break;
+			case LLC_MISSES:
+				attr.type = PERF_TYPE_HW_CACHE;
+				attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+					(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+				break;
+			default:
+				return -1;
+		}
+
+		// Текущий поток, любой процессор, без группы
+		long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		return fd < 0 ? -1 : static_cast<int>(fd);
+	}
+#endif
+
+	int fds_[EVENT_COUNT];
+	uint64_t values_[EVENT_COUNT];
+};
+
+#endif
@@ -0,0 +1,54 @@
+// Виртуальная машина Милана (vm.h).
+//
+// Использование: milan_vm [--count] <программа>
+//
+// Программа - вывод транслятора. Числа для INPUT читаются со стандартного ввода,
+// PRINT печатает на стандартный вывод. С --count число выполненных инструкций
+// печатается в стандартный поток ошибок.
+
+#include "vm.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+	bool count = false;
+	const char* fileName = NULL;
+	for(int i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "--count") == 0) {
+			count = true;
+		}
+		else if(argv[i][0] != '-' && fileName == NULL) {
+			fileName = argv[i];
+		}
+		else {
+			fileName = NULL;
+			break;
+		}
+	}
+	if(fileName == NULL) {
+		cerr << "Usage: milan_vm [--count] program" << endl;
+		return EXIT_FAILURE;
+	}
+
+	ifstream text(fileName);
+	if(!text) {
+		cerr << "File '" << fileName << "' not found" << endl;
+		return EXIT_FAILURE;
+	}
+
+	VirtualMachine vm;
+	if(!vm.load(text)) {
+		return EXIT_FAILURE;
+	}
+	bool ok = vm.run(cin, cout);
+	cout.flush();
+	if(count) {
+		cerr << "executed: " << vm.executed() << endl;
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,340 @@
+#ifndef CMILAN_VM_H
+#define CMILAN_VM_H
+
+// Виртуальная машина Милана для milan_vm и milan_bench.
+//
+// Программа загружается из текста, который печатает CodeGen: по строке
+// "адрес:<TAB>ИНСТРУКЦИЯ[<TAB>аргумент[<TAB>второй аргумент]]" на инструкцию,
+// адреса по порядку с нуля.
+// Память данных заполнена нулями, значения - 32-битные целые, сложение и
+// умножение идут по модулю 2^32 (так же считает константы Optimizer).
+// COMPARE снимает b, затем a и кладет 1, если "a op b", иначе 0; условные
+// переходы снимают условие со стека. SHL и SHR сдвигают на (аргумент & 31) бит,
+// SHR - с расширением знака; MULHI берет старшее слово знакового 64-битного
+// произведения. FOR_ENTRY и FOR_LOOP читают шаг с вершины стека и предел под ним,
+// не снимая их; FOR_LOOP сравнивает с пределом точную (64-битную) сумму.
+// TABLESWITCH переходит на одну из следующих за ним инструкций. Деление на
+// ноль, нехватка значений на стеке и переход за пределы программы - ошибки
+// времени выполнения.
+
+#include "../headers/codegen.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class VirtualMachine
+{
+public:
+	VirtualMachine()
+		: memorySize_(0), executed_(0)
+	{}
+
+	// Загрузка программы; при ошибке сообщение печатается в cerr
+	bool load(istream& text)
+	{
+		program_.clear();
+		memorySize_ = 0;
+		string line;
+		int lineNumber = 0;
+		while(getline(text, line)) {
+			++lineNumber;
+			istringstream fields(line);
+			int address;
+			char colon;
+			string name;
+			if(!(fields >> address)) {
+				continue;  // пустая строка
+			}
+			if(!(fields >> colon >> name) || colon != ':' || address != static_cast<int>(program_.size())) {
+				return fail(lineNumber, "malformed instruction");
+			}
+
+			Op op = { NOP, 0, 0 };
+			if(!parseInstruction(name, op.instruction)) {
+				return fail(lineNumber, "unknown instruction '" + name + "'");
+			}
+			if(hasArgument(op.instruction) && !(fields >> op.arg)) {
+				return fail(lineNumber, "argument expected");
+			}
+			if(hasSecondArgument(op.instruction) && !(fields >> op.arg2)) {
+				return fail(lineNumber, "second argument expected");
+			}
+			if(op.instruction == TABLESWITCH && op.arg2 < 0) {
+				return fail(lineNumber, "negative table size");
+			}
+			if(hasDataAddress(op.instruction) || hasSecondDataAddress(op.instruction)) {
+				int data = hasDataAddress(op.instruction) ? op.arg : op.arg2;
+				if(data < 0) {
+					return fail(lineNumber, "negative data address");
+				}
+				memorySize_ = max(memorySize_, static_cast<size_t>(data) + 1);
+			}
+			program_.push_back(op);
+		}
+		return true;
+	}
+
+	// Выполнение программы с чтением INPUT из input и печатью PRINT в output
+	bool run(istream& input, ostream& output)
+	{
+		vector<int> memory(memorySize_, 0);
+		vector<int> stack;
+		stack.reserve(64);
+		size_t pc = 0;
+		size_t size = program_.size();
+		executed_ = 0;
+
+		while(pc < size) {
+			const Op& op = program_[pc];
+			++executed_;
+			++pc;
+
+			// Снимаемые со стека значения проверяются до выполнения инструкции
+			size_t needs = pops(op.instruction);
+			if(stack.size() < needs) {
+				return error(pc - 1, "stack underflow");
+			}
+
+			switch(op.instruction) {
+				case NOP:
+					break;
+				case STOP:
+					return true;
+				case LOAD:
+					stack.push_back(memory[op.arg]);
+					break;
+				case STORE:
+					memory[op.arg] = stack.back();
+					stack.pop_back();
+					break;
+				case BLOAD: {
+					size_t address = static_cast<size_t>(op.arg) + stack.back();
+					if(address >= memory.size()) {
+						return error(pc - 1, "data address out of range");
+					}
+					stack.back() = memory[address];
+					break;
+				}
+				case BSTORE: {
+					size_t address = static_cast<size_t>(op.arg) + stack.back();
+					stack.pop_back();
+					if(address >= memory.size()) {
+						return error(pc - 1, "data address out of range");
+					}
+					memory[address] = stack.back();
+					stack.pop_back();
+					break;
+				}
+				case PUSH:
+					stack.push_back(op.arg);
+					break;
+				case POP:
+					stack.pop_back();
+					break;
+				case DUP:
+					stack.push_back(stack.back());
+					break;
+				case ADD:
+					binary(stack, static_cast<unsigned>(stack[stack.size() - 2]) + static_cast<unsigned>(stack.back()));
+					break;
+				case SUB:
+					binary(stack, static_cast<unsigned>(stack[stack.size() - 2]) - static_cast<unsigned>(stack.back()));
+					break;
+				case MULT:
+					binary(stack, static_cast<unsigned>(stack[stack.size() - 2]) * static_cast<unsigned>(stack.back()));
+					break;
+				case DIV: {
+					int b = stack.back();
+					int a = stack[stack.size() - 2];
+					if(b == 0) {
+						return error(pc - 1, "division by zero");
+					}
+					binary(stack, b == -1 ? 0u - static_cast<unsigned>(a) : static_cast<unsigned>(a / b));
+					break;
+				}
+				case INVERT:
+					stack.back() = static_cast<int>(0u - static_cast<unsigned>(stack.back()));
+					break;
+				case COMPARE: {
+					int b = stack.back();
+					int a = stack[stack.size() - 2];
+					bool result = false;
+					switch(op.arg) {
+						case 0: result = a == b; break;
+						case 1: result = a != b; break;
+						case 2: result = a < b; break;
+						case 3: result = a > b; break;
+						case 4: result = a <= b; break;
+						case 5: result = a >= b; break;
+						default: return error(pc - 1, "unknown comparison");
+					}
+					binary(stack, result);
+					break;
+				}
+				case JUMP:
+					pc = op.arg;
+					break;
+				case JUMP_YES:
+				case JUMP_NO: {
+					bool value = stack.back() != 0;
+					stack.pop_back();
+					if(value == (op.instruction == JUMP_YES)) {
+						pc = op.arg;
+					}
+					break;
+				}
+				case INPUT: {
+					int value;
+					if(!(input >> value)) {
+						return error(pc - 1, "integer expected on input");
+					}
+					stack.push_back(value);
+					break;
+				}
+				case PRINT:
+					output << stack.back() << '\n';
+					stack.pop_back();
+					break;
+				case BITAND:
+					binary(stack, stack[stack.size() - 2] & stack.back());
+					break;
+				case BITOR:
+					binary(stack, stack[stack.size() - 2] | stack.back());
+					break;
+				case NOT:
+					stack.back() = stack.back() == 0;
+					break;
+				case PUSH_TRUE:
+					stack.push_back(1);
+					break;
+				case PUSH_FALSE:
+					stack.push_back(0);
+					break;
+				case SHORT_AND:
+				case SHORT_OR:
+					// Если значение на вершине решает результат, оно остается на стеке
+					if((stack.back() != 0) == (op.instruction == SHORT_OR)) {
+						pc = op.arg;
+					}
+					else {
+						stack.pop_back();
+					}
+					break;
+				case SHL:
+					stack.back() = static_cast<int>(static_cast<unsigned>(stack.back()) << (op.arg & 31));
+					break;
+				case SHR:
+					stack.back() >>= op.arg & 31;
+					break;
+				case MULHI:
+					stack.back() = static_cast<int>((static_cast<int64_t>(stack.back()) * op.arg) >> 32);
+					break;
+				case FOR_ENTRY: {
+					int step = stack.back();
+					int limit = stack[stack.size() - 2];
+					int value = memory[op.arg2];
+					if(step == 0 || (step > 0 ? value > limit : value < limit)) {
+						pc = op.arg;
+					}
+					break;
+				}
+				case FOR_LOOP: {
+					int step = stack.back();
+					int limit = stack[stack.size() - 2];
+					int64_t value = static_cast<int64_t>(memory[op.arg2]) + step;
+					memory[op.arg2] = static_cast<int>(static_cast<uint32_t>(value));
+					if(step >= 0 ? value <= limit : value >= limit) {
+						pc = op.arg;
+					}
+					break;
+				}
+				case TABLESWITCH: {
+					unsigned index = static_cast<unsigned>(stack.back()) - static_cast<unsigned>(op.arg);
+					stack.pop_back();
+					pc += min(index, static_cast<unsigned>(op.arg2));
+					break;
+				}
+			}
+			if(pc > size) {
+				return error(pc, "jump out of program");
+			}
+		}
+		return true;
+	}
+
+	// Выполнено инструкций при последнем запуске run()
+	size_t executed() const
+	{
+		return executed_;
+	}
+
+	// Количество инструкций в программе
+	size_t size() const
+	{
+		return program_.size();
+	}
+
+private:
+	struct Op
+	{
+		Instruction instruction;
+		int arg;
+		int arg2;
+	};
+
+	static bool parseInstruction(const string& name, Instruction& result)
+	{
+		for(int i = NOP; i <= LAST_INSTRUCTION; ++i) {
+			if(name == instructionName(static_cast<Instruction>(i))) {
+				result = static_cast<Instruction>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Сколько значений инструкция снимает со стека (или читает с вершины)
+	static size_t pops(Instruction instruction)
+	{
+		switch(instruction) {
+			case ADD: case SUB: case MULT: case DIV: case COMPARE: case BITAND: case BITOR: case BSTORE:
+			case FOR_ENTRY: case FOR_LOOP:
+				return 2;
+			case STORE: case BLOAD: case POP: case DUP: case INVERT: case JUMP_YES: case JUMP_NO:
+			case PRINT: case NOT: case SHORT_AND: case SHORT_OR: case SHL: case SHR: case MULHI: case TABLESWITCH:
+				return 1;
+			default:
+				return 0;
+		}
+	}
+
+	// Замена двух значений на вершине стека результатом операции
+	static void binary(vector<int>& stack, unsigned result)
+	{
+		stack.pop_back();
+		stack.back() = static_cast<int>(result);
+	}
+
+	static bool fail(int line, const string& message)
+	{
+		cerr << "Line " << line << ": " << message << endl;
+		return false;
+	}
+
+	static bool error(size_t address, const string& message)
+	{
+		cerr << "Runtime error at " << address << ": " << message << endl;
+		return false;
+	}
+
+	vector<Op> program_;  // Программа
+	size_t memorySize_;   // Слов памяти данных: наибольший адрес LOAD/STORE + 1
+	size_t executed_;     // Счетчик для executed()
+};
+
+#endif